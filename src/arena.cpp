@@ -0,0 +1,152 @@
+#include "arena.h"
+
+#include <cassert>
+#include <cstring>
+#include <new>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+// mbind(2) policy and flag, without a dependency on libnuma
+#define CRC_MPOL_PREFERRED   1
+#define CRC_MPOL_MF_MOVE     (1 << 1)
+#define CRC_ARENA_MAX_NODES  1024
+
+ArenaPages CRC_ARENA::pages = ARENA_PAGES_THP;
+
+static inline size_t AlignUp( size_t bytes, size_t align )
+{
+    return (bytes + align - 1) & ~(align - 1);
+}
+
+CRC_ARENA::~CRC_ARENA()
+{
+    for(UINT32 c=0; c<chunks.size(); c++) munmap( chunks[c].base, chunks[c].bytes );
+}
+
+void CRC_ARENA::Reserve( size_t bytes )
+{
+    assert( chunks.empty() );
+
+    reserve = bytes;
+}
+
+void * CRC_ARENA::Alloc( size_t bytes )
+{
+    bytes = AlignUp( bytes ? bytes : 1, CRC_ARENA_ALIGN );
+
+    if( chunks.empty() || used + bytes > chunks.back().bytes )
+    {
+        // The first chunk is the reservation; later ones grow geometrically
+        size_t want = chunks.empty() ? reserve : Mapped();
+
+        if( want < CRC_ARENA_MIN_CHUNK ) want = CRC_ARENA_MIN_CHUNK;
+        MapChunk( want > bytes ? want : bytes );
+    }
+
+    void *p = chunks.back().base + used;
+    used += bytes;
+
+    return p;
+}
+
+size_t CRC_ARENA::Mapped() const
+{
+    size_t bytes = 0;
+
+    for(UINT32 c=0; c<chunks.size(); c++) bytes += chunks[c].bytes;
+
+    return bytes;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// A large chunk is rounded to whole huge pages. Without MAP_HUGETLB the      //
+// kernel only aligns mappings to base pages, so one huge page more is        //
+// mapped and the unaligned head and tail are unmapped again.                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_ARENA::MapChunk( size_t bytes )
+{
+    const size_t page = sysconf( _SC_PAGESIZE );
+    const int    prot = PROT_READ | PROT_WRITE;
+    const bool   huge = pages != ARENA_PAGES_SMALL && bytes >= CRC_ARENA_HUGE_PAGE;
+
+    CHUNK chunk;
+
+    chunk.bytes = AlignUp( bytes, huge ? CRC_ARENA_HUGE_PAGE : page );
+    chunk.base  = NULL;
+
+#ifdef MAP_HUGETLB
+    if( huge && pages == ARENA_PAGES_HUGETLB )
+    {
+        void *p = mmap( NULL, chunk.bytes, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0 );
+        if( p != MAP_FAILED ) chunk.base = (char *) p;
+    }
+#endif
+
+    if( chunk.base == NULL )
+    {
+        size_t span = huge ? chunk.bytes + CRC_ARENA_HUGE_PAGE : chunk.bytes;
+        void  *p    = mmap( NULL, span, prot, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+
+        if( p == MAP_FAILED )
+        {
+            cerr<<"arena: cannot map "<<span<<" bytes"<<endl;
+            throw bad_alloc();
+        }
+
+        chunk.base = (char *) p;
+
+        if( huge )
+        {
+            char *aligned = (char *) AlignUp( (size_t) chunk.base, CRC_ARENA_HUGE_PAGE );
+            char *end     = chunk.base + span;
+
+            if( aligned > chunk.base ) munmap( chunk.base, aligned - chunk.base );
+            if( end > aligned + chunk.bytes ) munmap( aligned + chunk.bytes, end - (aligned + chunk.bytes) );
+            chunk.base = aligned;
+
+#ifdef MADV_HUGEPAGE
+            madvise( chunk.base, chunk.bytes, MADV_HUGEPAGE );
+#endif
+        }
+    }
+
+    chunks.push_back( chunk );
+    used = 0;
+}
+
+void CRC_ARENA::MoveToLocalNode()
+{
+#if defined(SYS_mbind) && defined(SYS_getcpu)
+    static const bool multiNode = access( "/sys/devices/system/node/node1", F_OK ) == 0;
+
+    const UINT32  bits = 8 * sizeof(unsigned long);
+    unsigned long mask[ CRC_ARENA_MAX_NODES / (8 * sizeof(unsigned long)) ];
+    unsigned      cpu, node;
+
+    if( !multiNode || chunks.empty() ) return;
+    if( syscall( SYS_getcpu, &cpu, &node, NULL ) != 0 || node >= CRC_ARENA_MAX_NODES ) return;
+
+    memset( mask, 0, sizeof(mask) );
+    mask[ node / bits ] |= 1UL << (node % bits);
+
+    // Best effort: pages that cannot move stay where they are
+    for(UINT32 c=0; c<chunks.size(); c++)
+    {
+        syscall( SYS_mbind, chunks[c].base, chunks[c].bytes, CRC_MPOL_PREFERRED, mask,
+                 CRC_ARENA_MAX_NODES + 1, CRC_MPOL_MF_MOVE );
+    }
+#endif
+}
+
+bool CRC_ARENA::ParsePages( const char *name, ArenaPages *_pages )
+{
+    if( strcmp( name, "thp" ) == 0 )          *_pages = ARENA_PAGES_THP;
+    else if( strcmp( name, "hugetlb" ) == 0 ) *_pages = ARENA_PAGES_HUGETLB;
+    else if( strcmp( name, "small" ) == 0 )   *_pages = ARENA_PAGES_SMALL;
+    else return false;
+
+    return true;
+}
@@ -0,0 +1,93 @@
+#ifndef CRC_ARENA_H
+#define CRC_ARENA_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Memory arena for the per-set state of a cache. CRC_CACHE reserves one      //
+// anonymous mapping big enough for its tag store, replacement state and      //
+// statistics, and every array is carved out of it by bumping a pointer.      //
+// Nothing is freed on its own: the whole mapping goes away with the arena,   //
+// so destroying a cache is a handful of munmap calls however many sets it    //
+// has.                                                                       //
+//                                                                            //
+// The reservation is virtual only (MAP_NORESERVE), so a generous estimate    //
+// costs nothing; pages are backed when first touched. A request that does    //
+// not fit maps another chunk. Mappings of at least CRC_ARENA_HUGE_PAGE are   //
+// aligned to it and, depending on SetPages, backed by transparent huge       //
+// pages (the default) or by the hugetlbfs pool (MAP_HUGETLB, falling back    //
+// to transparent huge pages when the pool is too small).                     //
+//                                                                            //
+// Memory handed out is always zero: it comes straight from the kernel and    //
+// is never reused.                                                           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include <vector>
+#include "utils.h"
+
+#define CRC_ARENA_ALIGN      64                 // every allocation starts a cache line
+#define CRC_ARENA_HUGE_PAGE  (2UL << 20)
+#define CRC_ARENA_MIN_CHUNK  (64UL << 10)
+
+enum ArenaPages
+{
+    ARENA_PAGES_THP      = 0,   // madvise(MADV_HUGEPAGE) on large chunks
+    ARENA_PAGES_HUGETLB  = 1,   // MAP_HUGETLB on large chunks
+    ARENA_PAGES_SMALL    = 2    // base pages only
+};
+
+class CRC_ARENA
+{
+  private:
+
+    typedef struct
+    {
+        char   *base;
+        size_t  bytes;
+    } CHUNK;
+
+    vector<CHUNK>   chunks;
+    size_t          used;       // bytes handed out of the last chunk
+    size_t          reserve;    // size of the first chunk
+
+    static ArenaPages pages;
+
+  public:
+
+    CRC_ARENA() : used( 0 ), reserve( 0 ) {}
+    ~CRC_ARENA();
+
+    // Size the first mapping; only before the first Alloc
+    void    Reserve( size_t bytes );
+
+    // bytes of zeroed memory, CRC_ARENA_ALIGN-aligned, owned by the arena
+    void *  Alloc( size_t bytes );
+
+    template <class T>
+    T *     Alloc( size_t count ) { return (T *) Alloc( count * sizeof(T) ); }
+
+    // Bytes mapped so far, and how many mappings they are in
+    size_t  Mapped() const;
+    UINT32  Chunks() const { return chunks.size(); }
+
+    // Migrate the pages to the NUMA node of the calling thread, so that a
+    // cache built by one thread and simulated by another is local to the
+    // latter; nothing happens on single-node hosts
+    void    MoveToLocalNode();
+
+    // Page size used by arenas created from now on (process-wide)
+    static void        SetPages( ArenaPages _pages ) { pages = _pages; }
+    static ArenaPages  Pages() { return pages; }
+    static bool        ParsePages( const char *name, ArenaPages *_pages );
+
+  private:
+
+    void    MapChunk( size_t bytes );
+
+    CRC_ARENA( const CRC_ARENA & );
+    CRC_ARENA & operator=( const CRC_ARENA & );
+};
+
+#endif
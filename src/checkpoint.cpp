@@ -0,0 +1,205 @@
+#include "checkpoint.h"
+
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static inline COUNTER AlignUp( COUNTER bytes )
+{
+    return (bytes + CRC_CHECKPOINT_ALIGN - 1) & ~(COUNTER) (CRC_CHECKPOINT_ALIGN - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Writer: the file is written front to back; errors are remembered and       //
+// reported by Close                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool CRC_CHECKPOINT_WRITER::Open( const char *_path, const CRC_CHECKPOINT_HEADER &header )
+{
+    assert( file == NULL );
+
+    path    = _path;
+    offset  = 0;
+    pending = 0;
+
+    file = fopen( path, "wb" );
+    if( file == NULL )
+    {
+        cerr<<"checkpoint: cannot create "<<path<<endl;
+        return false;
+    }
+
+    ok = true;
+    Write( &header, sizeof(header) );
+    Pad();
+
+    return ok;
+}
+
+void CRC_CHECKPOINT_WRITER::Write( const void *data, size_t bytes )
+{
+    if( ok && bytes && fwrite( data, 1, bytes, file ) != bytes ) ok = false;
+    offset += bytes;
+}
+
+void CRC_CHECKPOINT_WRITER::Pad()
+{
+    static const char zeros[ CRC_CHECKPOINT_ALIGN ] = { 0 };
+
+    Write( zeros, AlignUp( offset ) - offset );
+}
+
+void CRC_CHECKPOINT_WRITER::BeginSection( UINT32 tag, size_t bytes )
+{
+    CRC_CHECKPOINT_SECTION section;
+
+    assert( file && pending == 0 );
+
+    memset( &section, 0, sizeof(section) );
+    section.tag   = tag;
+    section.bytes = bytes;
+
+    Write( &section, sizeof(section) );
+    pending = bytes;
+    if( pending == 0 ) Pad();
+}
+
+void CRC_CHECKPOINT_WRITER::Append( const void *data, size_t bytes )
+{
+    assert( bytes <= pending );
+
+    Write( data, bytes );
+    pending -= bytes;
+    if( pending == 0 ) Pad();
+}
+
+void CRC_CHECKPOINT_WRITER::Section( UINT32 tag, const void *data, size_t bytes )
+{
+    BeginSection( tag, bytes );
+    if( bytes ) Append( data, bytes );
+}
+
+bool CRC_CHECKPOINT_WRITER::Close()
+{
+    if( file == NULL ) return true;
+
+    assert( pending == 0 );
+
+    if( fclose( file ) != 0 ) ok = false;
+    file = NULL;
+
+    if( !ok ) cerr<<"checkpoint: write to "<<path<<" failed"<<endl;
+
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Reader: the whole file is mapped and populated up front, since every byte  //
+// of it is copied out                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool CRC_CHECKPOINT_READER::Open( const char *_path )
+{
+    Close();
+
+    path = _path;
+
+    int fd = open( path, O_RDONLY );
+    if( fd < 0 )
+    {
+        cerr<<"checkpoint: cannot open "<<path<<endl;
+        return false;
+    }
+
+    struct stat st;
+    if( fstat( fd, &st ) != 0 || (size_t) st.st_size < sizeof(CRC_CHECKPOINT_HEADER) )
+    {
+        cerr<<"checkpoint: "<<path<<" is too short"<<endl;
+        close( fd );
+        return false;
+    }
+
+    int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+    flags |= MAP_POPULATE;
+#endif
+
+    void *addr = mmap( NULL, st.st_size, PROT_READ, flags, fd, 0 );
+    close( fd );
+
+    if( addr == MAP_FAILED )
+    {
+        cerr<<"checkpoint: cannot map "<<path<<endl;
+        return false;
+    }
+
+    map      = (const char *) addr;
+    mapBytes = st.st_size;
+    offset   = AlignUp( sizeof(CRC_CHECKPOINT_HEADER) );
+
+    if( Header().magic != CRC_CHECKPOINT_MAGIC || Header().version != CRC_CHECKPOINT_VERSION )
+    {
+        cerr<<"checkpoint: "<<path<<" is not a checkpoint of this version"<<endl;
+        Close();
+        return false;
+    }
+
+    return true;
+}
+
+void CRC_CHECKPOINT_READER::Close()
+{
+    if( map ) munmap( (void *) map, mapBytes );
+
+    map      = NULL;
+    mapBytes = 0;
+    offset   = 0;
+}
+
+const void * CRC_CHECKPOINT_READER::Section( UINT32 tag, size_t bytes )
+{
+    assert( map );
+
+    if( offset + sizeof(CRC_CHECKPOINT_SECTION) > mapBytes )
+    {
+        cerr<<"checkpoint: "<<path<<" is truncated"<<endl;
+        return NULL;
+    }
+
+    const CRC_CHECKPOINT_SECTION *section = (const CRC_CHECKPOINT_SECTION *) (map + offset);
+
+    if( section->tag != tag || section->bytes != bytes )
+    {
+        cerr<<"checkpoint: "<<path<<" has section "<<section->tag<<" of "<<section->bytes
+            <<" bytes where section "<<tag<<" of "<<bytes<<" bytes was expected"<<endl;
+        return NULL;
+    }
+
+    size_t data = offset + sizeof(CRC_CHECKPOINT_SECTION);
+
+    if( data + bytes > mapBytes )
+    {
+        cerr<<"checkpoint: "<<path<<" is truncated"<<endl;
+        return NULL;
+    }
+
+    offset = AlignUp( data + bytes );
+
+    return map + data;
+}
+
+bool CRC_CHECKPOINT_READER::Read( UINT32 tag, void *data, size_t bytes )
+{
+    const void *payload = Section( tag, bytes );
+
+    if( payload == NULL ) return false;
+
+    memcpy( data, payload, bytes );
+
+    return true;
+}
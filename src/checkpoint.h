@@ -0,0 +1,142 @@
+#ifndef CRC_CHECKPOINT_H
+#define CRC_CHECKPOINT_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Checkpoint files of a warmed cache (CRC_CACHE::SaveCheckpoint and          //
+// RestoreCheckpoint). A header with the cache geometry is followed by        //
+// sections, each a small header (tag and size) and the raw bytes of one      //
+// state array, padded to CRC_CHECKPOINT_ALIGN. Every component writes and    //
+// reads its own sections in a fixed order; the reader checks the tag and     //
+// size of each before copying it out.                                        //
+//                                                                            //
+// The reader maps the whole file, so restoring is one copy per state array   //
+// straight out of the page cache instead of a re-simulation of the warmup.   //
+// Checkpoints are raw host memory images: they are only read back on hosts   //
+// of the same endianness and by builds with the same state layout, which     //
+// the version number is bumped for.                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include <cstddef>
+#include "utils.h"
+
+#define CRC_CHECKPOINT_MAGIC    0x0031544b50484343ULL   // "CCHKPT1\0"
+#define CRC_CHECKPOINT_VERSION  3
+#define CRC_CHECKPOINT_ALIGN    64
+
+// Section tags, in file order
+enum CheckpointSection
+{
+    CKPT_TAG_STORE      = 1,
+    CKPT_CACHE_STATS    = 2,
+    CKPT_CACHE_COUNTERS = 3,
+    CKPT_SAMPLE_STATS   = 4,
+    CKPT_REPL_COUNTERS  = 5,
+    CKPT_REPL_STREAMS   = 6,
+    CKPT_REPL_LRU       = 7,
+    CKPT_REPL_RRPV      = 8,
+    CKPT_REPL_BIMODAL   = 9,
+    CKPT_REPL_PLRU      = 10,
+    CKPT_REPL_LINES     = 11,
+    CKPT_DUEL_CONFIG    = 12,
+    CKPT_DUEL_SELECTORS = 13,
+    CKPT_SHIP_CONFIG    = 14,
+    CKPT_SHIP_COUNTERS  = 15,
+    CKPT_SHIP_OWNERS    = 16,
+    CKPT_SHIP_STATE     = 17
+};
+
+// File header, always at offset 0
+typedef struct
+{
+    COUNTER     magic;          // CRC_CHECKPOINT_MAGIC
+    UINT32      version;        // CRC_CHECKPOINT_VERSION
+    UINT32      numsets;
+    UINT32      assoc;
+    UINT32      linesize;
+    UINT32      threads;
+    UINT32      policy;         // replacement policy of the saved state
+    UINT32      sampleRatio;    // set sampling, 1 if all sets are simulated
+    UINT32      reserved;
+    COUNTER     accesses;       // simulated accesses when saved
+} CRC_CHECKPOINT_HEADER;
+
+// Section header, CRC_CHECKPOINT_ALIGN-aligned in the file
+typedef struct
+{
+    UINT32      tag;            // CheckpointSection
+    UINT32      reserved;
+    COUNTER     bytes;          // payload, not counting the padding
+} CRC_CHECKPOINT_SECTION;
+
+class CRC_CHECKPOINT_WRITER
+{
+  private:
+
+    FILE       *file;
+    const char *path;
+    bool        ok;
+    COUNTER     offset;         // bytes written so far
+    COUNTER     pending;        // bytes still owed to the open section
+
+  public:
+
+    CRC_CHECKPOINT_WRITER() : file( NULL ), path( NULL ), ok( false ), offset( 0 ), pending( 0 ) {}
+    ~CRC_CHECKPOINT_WRITER() { Close(); }
+
+    bool    Open( const char *_path, const CRC_CHECKPOINT_HEADER &header );
+
+    // A whole section, or one assembled from several Append calls that add
+    // up to bytes (for state kept in more than one allocation)
+    void    Section( UINT32 tag, const void *data, size_t bytes );
+    void    BeginSection( UINT32 tag, size_t bytes );
+    void    Append( const void *data, size_t bytes );
+
+    // False if anything could not be written
+    bool    Close();
+
+  private:
+
+    void    Write( const void *data, size_t bytes );
+    void    Pad();
+
+    CRC_CHECKPOINT_WRITER( const CRC_CHECKPOINT_WRITER & );
+    CRC_CHECKPOINT_WRITER & operator=( const CRC_CHECKPOINT_WRITER & );
+};
+
+class CRC_CHECKPOINT_READER
+{
+  private:
+
+    const char *path;
+    const char *map;
+    size_t      mapBytes;
+    size_t      offset;         // next section header
+
+  public:
+
+    CRC_CHECKPOINT_READER() : path( NULL ), map( NULL ), mapBytes( 0 ), offset( 0 ) {}
+    ~CRC_CHECKPOINT_READER() { Close(); }
+
+    bool    Open( const char *_path );
+    void    Close();
+
+    const CRC_CHECKPOINT_HEADER & Header() const { return *(const CRC_CHECKPOINT_HEADER *) map; }
+
+    // The payload of the next section, which must have this tag and size;
+    // NULL (with an explanation on cerr) otherwise
+    const void * Section( UINT32 tag, size_t bytes );
+
+    // Copy the next section into data; false if it does not match
+    bool    Read( UINT32 tag, void *data, size_t bytes );
+
+  private:
+
+    CRC_CHECKPOINT_READER( const CRC_CHECKPOINT_READER & );
+    CRC_CHECKPOINT_READER & operator=( const CRC_CHECKPOINT_READER & );
+};
+
+#endif
@@ -0,0 +1,166 @@
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Microbenchmark for the per-access cost of CRC_CACHE. Replays a synthetic   //
+// access stream through every replacement policy three times: through the    //
+// generic path that dispatches on the policy at every access, through the    //
+// path specialized for the policy at construction, and through the batched   //
+// specialized path that prefetches sets ahead, and prints the nanoseconds    //
+// per access of each. Prefetching pays off once the modeled cache is much    //
+// larger than the host caches (-s 65536).                                    //
+//                                                                            //
+// The stream mixes a reused working set with a streaming component so that   //
+// both hits and victim selection are exercised.                              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <iomanip>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "crc_cache.h"
+#include "trace.h"
+
+static void Usage( const char *prog )
+{
+    cerr<<"usage: "<<prog<<" [options]"<<endl;
+    cerr<<"  -n <accesses>  accesses per run (default 4M)"<<endl;
+    cerr<<"  -s <size>      cache size in KB (default 4096)"<<endl;
+    cerr<<"  -a <assoc>     associativity (default 16)"<<endl;
+    cerr<<"  -r <runs>      runs per configuration, the fastest is reported (default 3)"<<endl;
+    exit(1);
+}
+
+static double Now()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function builds the synthetic stream: 3/4 of the accesses go to a      //
+// working set of twice the cache size, the rest stream through new lines.    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+static void MakeStream( TRACE_RECORD *recs, COUNTER n, UINT32 cacheSize )
+{
+    COUNTER x        = 0x9e3779b97f4a7c15ULL;
+    COUNTER hotLines = 2 * (COUNTER) cacheSize / 64;
+    Addr_t  stream   = 1ULL << 40;
+
+    for(COUNTER i=0; i<n; i++)
+    {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+
+        recs[i].tid        = (UINT32) (x >> 62);
+        recs[i].PC         = 0x400000 + ((x >> 20) & 0xfff) * 4;
+        recs[i].accessType = ((x >> 8) & 7) == 0 ? ACCESS_STORE : ACCESS_LOAD;
+
+        if( (x & 3) != 0 ) recs[i].paddr = ((x >> 24) % hotLines) * 64;
+        else               recs[i].paddr = (stream += 64);
+    }
+}
+
+// Lookup paths measured
+enum BenchPath
+{
+    BENCH_RUNTIME      = 0,
+    BENCH_SPECIALIZED  = 1,
+    BENCH_BATCHED      = 2,
+    BENCH_WARMUP       = 3,     // batched, with the whole run in warmup
+    BENCH_PATHS        = 4
+};
+
+#define BENCH_BATCH  256        // records per LookupAndFillBatch call
+
+static double RunOnce( const TRACE_RECORD *recs, COUNTER n, UINT32 cacheSize, UINT32 assoc,
+                       UINT32 policy, UINT32 path )
+{
+    CRC_CACHE cache( cacheSize, assoc, 4, 64, policy );
+    cache.UseRuntimeDispatch( path == BENCH_RUNTIME );
+    if( path == BENCH_WARMUP ) cache.BeginWarmup( n );
+
+    double start = Now();
+
+    if( path == BENCH_BATCHED || path == BENCH_WARMUP )
+    {
+        for(COUNTER i=0; i<n; i+=BENCH_BATCH)
+        {
+            cache.LookupAndFillBatch( recs + i, (UINT32) (n - i < BENCH_BATCH ? n - i : BENCH_BATCH) );
+        }
+    }
+    else
+    {
+        for(COUNTER i=0; i<n; i++)
+        {
+            cache.LookupAndFillCache( recs[i].tid, recs[i].PC, recs[i].paddr, recs[i].accessType );
+        }
+    }
+
+    return (Now() - start) * 1e9 / n;
+}
+
+int main( int argc, char **argv )
+{
+    COUNTER n         = 4 << 20;
+    UINT32  cacheSize = 4 << 20;
+    UINT32  assoc     = 16;
+    UINT32  runs      = 3;
+    int     opt;
+
+    while( (opt = getopt( argc, argv, "n:s:a:r:h" )) != -1 )
+    {
+        switch( opt )
+        {
+            case 'n': n         = strtoull( optarg, NULL, 0 ); break;
+            case 's': cacheSize = strtoul( optarg, NULL, 0 ) << 10; break;
+            case 'a': assoc     = strtoul( optarg, NULL, 0 ); break;
+            case 'r': runs      = strtoul( optarg, NULL, 0 ); break;
+            default:  Usage( argv[0] );
+        }
+    }
+
+    if( n == 0 || cacheSize == 0 || assoc == 0 || runs == 0 ) Usage( argv[0] );
+
+    TRACE_RECORD *recs = new TRACE_RECORD[ n ];
+    MakeStream( recs, n, cacheSize );
+
+    cout<<"Accesses: "<<n<<"  Cache: "<<(cacheSize >> 10)<<"K  Assoc: "<<assoc<<endl;
+    cout<<left<<setw(10)<<"Policy"<<right<<setw(14)<<"runtime ns"<<setw(16)<<"specialized ns"
+        <<setw(10)<<"speedup"<<setw(12)<<"batched ns"<<setw(10)<<"speedup"
+        <<setw(11)<<"warmup ns"<<setw(10)<<"speedup"<<endl;
+
+    for(UINT32 p=0; p<CRC_REPL_MAX; p++)
+    {
+        // OPT needs a real trace
+        if( p == CRC_REPL_OPT ) continue;
+
+        double best[ BENCH_PATHS ];
+
+        for(UINT32 r=0; r<runs; r++)
+        {
+            for(UINT32 b=0; b<BENCH_PATHS; b++)
+            {
+                double t = RunOnce( recs, n, cacheSize, assoc, p, b );
+                if( r == 0 || t < best[b] ) best[b] = t;
+            }
+        }
+
+        cout<<left<<setw(10)<<crc_repl_names[p]<<right<<fixed<<setprecision(2)
+            <<setw(14)<<best[ BENCH_RUNTIME ]<<setw(16)<<best[ BENCH_SPECIALIZED ]
+            <<setw(9)<<best[ BENCH_RUNTIME ] / best[ BENCH_SPECIALIZED ]<<"x"
+            <<setw(12)<<best[ BENCH_BATCHED ]
+            <<setw(9)<<best[ BENCH_SPECIALIZED ] / best[ BENCH_BATCHED ]<<"x"
+            <<setw(11)<<best[ BENCH_WARMUP ]
+            <<setw(9)<<best[ BENCH_BATCHED ] / best[ BENCH_WARMUP ]<<"x"<<endl;
+    }
+
+    delete [] recs;
+
+    return 0;
+}
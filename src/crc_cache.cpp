@@ -1,5 +1,9 @@
 #include "crc_cache.h"
 
+#include <cmath>
+#include <sstream>
+#include <cstring>
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
@@ -22,7 +26,7 @@
 // IMPORTANT NOTE: DO NOT CHANGE ANYTHING IN THIS HEADER FILE. Changing anything
 // in here will violate the competition rules.
 
-string crc_access_names[] =
+string crc_access_names[ ACCESS_MAX ] =
 {
     "IFETCH   ",
     "LOAD     ",
@@ -42,8 +46,27 @@ CRC_CACHE::CRC_CACHE( UINT32 _cacheSize, UINT32 _assoc, UINT32 _tpc, UINT32 _lin
 {
 
     // Start off with empty cache and replacement state
-    cache          = NULL;
-    cacheReplState = NULL;
+    cache            = NULL;
+    cacheReplState   = NULL;
+    victimSet        = NULL;
+    lineStateViews   = false;
+    writebackUpdates = false;
+    lookupAndFill    = NULL;
+    lookupAndFillBatch = NULL;
+    runtimeDispatch  = false;
+
+    // Only one thread accesses the cache until EnableSharedAccess is called
+    shared      = false;
+    setLocks    = NULL;
+    setLockMask = 0;
+
+    // Every set is simulated until EnableSetSampling is called
+    sampledSet     = NULL;
+    sampleRatio    = 1;
+    skipped        = 0;
+    for(UINT32 i=0; i<SAMPLE_STATS; i++) setStats[i] = NULL;
+
+    warmupLeft     = 0;
 
     // Initialize parameters to the cache
     numsets  = _cacheSize / (_linesize * _assoc);
@@ -51,8 +74,17 @@ CRC_CACHE::CRC_CACHE( UINT32 _cacheSize, UINT32 _assoc, UINT32 _tpc, UINT32 _lin
     threads  = _tpc;
     linesize = _linesize;
 
+    assert( threads >= 1 && threads <= CRC_MAX_THREADS );
+
     replPolicy = _pol;
 
+    // Reserve the arena for the per-set state: tags and sharing bits and the
+    // per-line state of the policy (at most OPT's next uses) come to less
+    // than 32 bytes a way, the per-set words and tag padding fit in 8 ways
+    // more. Only what is used gets backed by memory.
+    arena.Reserve( (size_t) numsets * (assoc + 8) * 32 + (size_t) threads * assoc * sizeof(LINE_STATE)
+                   + CRC_ARENA_MIN_CHUNK );
+
     // Initialize the cache
     InitCache();
 
@@ -61,6 +93,25 @@ CRC_CACHE::CRC_CACHE( UINT32 _cacheSize, UINT32 _assoc, UINT32 _tpc, UINT32 _lin
 
     // Initialize the stats
     InitStats();
+
+    instrument = NULL;
+    if( CRC_INSTRUMENTED ) instrument = new CRC_INSTRUMENT( numsets, assoc );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The destructor: the per-set arrays are released with the arena, after the  //
+// objects that point into it                                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+CRC_CACHE::~CRC_CACHE()
+{
+    CloseSnapshots();
+
+    delete instrument;
+    delete cacheReplState;
+    delete cache;
+    delete [] setLocks;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -75,30 +126,25 @@ void CRC_CACHE::InitCache()
     indexShift = CRC_FloorLog2( numsets );    
     indexMask  = (1 << indexShift) - 1;
 
-    // Create the cache structure (first create the sets)
-    cache = new LINE_STATE* [ numsets ];
+    // Create the cache structure: one flat tag store for all sets and ways
+    cache = new CRC_TAG_STORE( numsets, assoc, &arena );
 
     // ensure that we were able to create cache
     assert(cache);
 
-    // If we were able to create the sets, now create the ways
-    for(UINT32 setIndex=0; setIndex<numsets; setIndex++) 
-    {
-        cache[ setIndex ] = new LINE_STATE[ assoc ];
-
-        // Initialize the cache ways
-        for(UINT32 way=0; way<assoc; way++) 
-        {
-            cache[ setIndex ][ way ].tag   = 0xdeaddead;
-            cache[ setIndex ][ way ].valid = false;
-            cache[ setIndex ][ way ].dirty = false;
-            cache[ setIndex ][ way ].sharing_dir   = 0;
-        }
-    }
+    // Scratch sets handed to the replacement policy on victim selection,
+    // one per thread for shared mode
+    victimSet = arena.Alloc<LINE_STATE>( threads * assoc );
 
     // Initialize cache access timer
     mytimer = 0;
 
+    // No snapshots until OpenSnapshots is called
+    snapshots        = NULL;
+    snapshotInterval = 0;
+    nextSnapshot     = ~(COUNTER) 0;
+    lastSnapshot     = ~(COUNTER) 0;
+
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -108,17 +154,15 @@ void CRC_CACHE::InitCache()
 ////////////////////////////////////////////////////////////////////////////////
 void CRC_CACHE::InitStats()
 {
-    for(UINT32 i=0; i<ACCESS_MAX; i++) 
-    {
-        lookups[i] = new COUNTER[ threads ];
-        misses[i]  = new COUNTER[ threads ];
-        hits[i]    = new COUNTER[ threads ];
+    stats = arena.Alloc<CRC_THREAD_STATS>( threads );
 
-        for(UINT32 t=0; t<threads; t++) 
+    for(UINT32 t=0; t<threads; t++) 
+    {
+        for(UINT32 i=0; i<ACCESS_MAX; i++) 
         {
-            lookups[i][t] = 0;
-            misses[i][t]  = 0;
-            hits[i][t]    = 0;
+            stats[t].lookups[i] = 0;
+            stats[t].misses[i]  = 0;
+            stats[t].hits[i]    = 0;
         }
     }
 }
@@ -145,7 +189,7 @@ ostream & CRC_CACHE::PrintStats(ostream &out)
     out<<"\tTot # Threads:  "<<threads<<endl;
     
     out<<endl;
-    out<<"Cache Statistics: "<<endl;
+    out<<(sampledSet ? "Cache Statistics (sampled sets only): " : "Cache Statistics: ")<<endl;
     out<<endl;
     
     for(UINT32 a=0; a<ACCESS_MAX; a++) 
@@ -157,9 +201,9 @@ ostream & CRC_CACHE::PrintStats(ostream &out)
 
         for(UINT32 t=0; t<threads; t++) 
         {
-            totLookups += lookups[a][t];
-            totMisses  += misses[a][t];
-            totHits    += hits[a][t];
+            totLookups += stats[t].lookups[a];
+            totMisses  += stats[t].misses[a];
+            totHits    += stats[t].hits[a];
         }
 
         if( totLookups ) 
@@ -190,6 +234,9 @@ ostream & CRC_CACHE::PrintStats(ostream &out)
     }
     out<<endl;
 
+    if( sampledSet ) PrintSamplingStats( out );
+    if( instrument ) instrument->PrintStats( out );
+
     cacheReplState->PrintStats( out );
      
     return out;
@@ -197,51 +244,315 @@ ostream & CRC_CACHE::PrintStats(ostream &out)
 
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
-// The function slects a victim for the given set index. We enforce that      //
-// we first fill all invalid entries. Once all invalid entries are filled     //
-// the replacement policy is consulted to find the victim                     //
+// The function prints the cache configuration and statistics as JSON for     //
+// scripts; the access types are named without the padding of the text stats  //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
-INT32 CRC_CACHE::GetVictimInSet( UINT32 tid, UINT32 setIndex, Addr_t PC, Addr_t paddr, UINT32 accessType ) 
+ostream & CRC_CACHE::PrintJSON(ostream &out)
 {
-    // Get pointer to replacement state of current set
-    LINE_STATE *vicSet = cache[ setIndex ];
+    out<<"{"<<endl;
+    out<<"  \"cache\": { \"size\": "<<(COUNTER) numsets * assoc * linesize<<", \"linesize\": "<<linesize
+       <<", \"assoc\": "<<assoc<<", \"sets\": "<<numsets<<", \"threads\": "<<threads
+       <<", \"policy\": \""<<crc_repl_names[ replPolicy ]<<"\", \"sampled\": "<<(sampledSet ? "true" : "false")
+       <<" },"<<endl;
 
-    // First find and fill invalid lines
-    for(UINT32 way=0; way<assoc; way++) 
+    out<<"  \"access_types\": {";
+    bool first = true;
+    for(UINT32 a=0; a<ACCESS_MAX; a++)
     {
-        if( vicSet[way].valid == false ) 
+        COUNTER totLookups = 0, totMisses = 0, totHits = 0;
+
+        for(UINT32 t=0; t<threads; t++)
         {
-            return way;
+            totLookups += stats[t].lookups[a];
+            totMisses  += stats[t].misses[a];
+            totHits    += stats[t].hits[a];
         }
+
+        if( totLookups == 0 ) continue;
+
+        string name = crc_access_names[a];
+        name.erase( name.find_last_not_of( ' ' ) + 1 );
+
+        out<<(first ? "" : ",")<<endl<<"    \""<<name<<"\": { \"accesses\": "<<totLookups
+           <<", \"misses\": "<<totMisses<<", \"hits\": "<<totHits<<" }";
+        first = false;
     }
+    out<<endl<<"  },"<<endl;
 
-    // If no invalid lines, then replace based on replacement policy
-    return cacheReplState->GetVictimInSet( tid, setIndex, vicSet, assoc, PC, paddr, accessType );
+    out<<"  \"threads\": [";
+    for(UINT32 t=0; t<threads; t++)
+    {
+        out<<(t ? "," : "")<<endl<<"    { \"demand_lookups\": "<<ThreadDemandLookupStats(t)
+           <<", \"demand_misses\": "<<ThreadDemandMissStats(t)<<", \"demand_hits\": "<<ThreadDemandHitStats(t)<<" }";
+    }
+    out<<endl<<"  ]";
+
+    if( instrument )
+    {
+        out<<","<<endl<<"  \"instrumentation\": ";
+        instrument->PrintJSON( out );
+    }
+    out<<endl<<"}"<<endl;
+
+    return out;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
-// The function looks up the set for the tag and returns physical way index   //
-// if the tag was a hit. Else returns -1 if it was a miss.                    //
+// Checkpoints: the header holds everything the layout of the state depends   //
+// on; the replacement state comes last so that it can be left out when the   //
+// policies differ                                                            //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
-INT32 CRC_CACHE::LookupSet( UINT32 setIndex, Addr_t tag )
+bool CRC_CACHE::SaveCheckpoint( const char *path )
+{
+    assert( !shared );
+
+    if( replPolicy == CRC_REPL_OPT )
+    {
+        cerr<<"checkpoint: OPT caches cannot be checkpointed"<<endl;
+        return false;
+    }
+
+    CRC_CHECKPOINT_HEADER header;
+    memset( &header, 0, sizeof(header) );
+    header.magic       = CRC_CHECKPOINT_MAGIC;
+    header.version     = CRC_CHECKPOINT_VERSION;
+    header.numsets     = numsets;
+    header.assoc       = assoc;
+    header.linesize    = linesize;
+    header.threads     = threads;
+    header.policy      = replPolicy;
+    header.sampleRatio = sampleRatio;
+    header.accesses    = mytimer;
+
+    CRC_CHECKPOINT_WRITER ckpt;
+    if( !ckpt.Open( path, header ) ) return false;
+
+    COUNTER counters[2] = { mytimer, skipped };
+
+    cache->Save( &ckpt );
+    ckpt.Section( CKPT_CACHE_STATS, stats, threads * sizeof(CRC_THREAD_STATS) );
+    ckpt.Section( CKPT_CACHE_COUNTERS, counters, sizeof(counters) );
+
+    if( sampledSet )
+    {
+        ckpt.BeginSection( CKPT_SAMPLE_STATS, SAMPLE_STATS * numsets * sizeof(COUNTER) );
+        for(UINT32 i=0; i<SAMPLE_STATS; i++) ckpt.Append( setStats[i], numsets * sizeof(COUNTER) );
+    }
+
+    cacheReplState->Save( &ckpt );
+
+    return ckpt.Close();
+}
+
+bool CRC_CACHE::RestoreCheckpoint( const char *path )
 {
-    // Get pointer to current set
-    LINE_STATE *currSet = cache[ setIndex ];
+    assert( mytimer == 0 && !shared && snapshots == NULL );
+
+    if( replPolicy == CRC_REPL_OPT )
+    {
+        cerr<<"checkpoint: OPT caches cannot be restored"<<endl;
+        return false;
+    }
+
+    CRC_CHECKPOINT_READER ckpt;
+    if( !ckpt.Open( path ) ) return false;
+
+    const CRC_CHECKPOINT_HEADER &header = ckpt.Header();
+
+    if( header.numsets != numsets || header.assoc != assoc || header.linesize != linesize
+        || header.threads != threads || header.sampleRatio != sampleRatio )
+    {
+        cerr<<"checkpoint: "<<path<<" is of a "<<header.numsets<<" x "<<header.assoc<<" cache of "
+            <<header.linesize<<"-byte lines, "<<header.threads<<" threads and sampling 1/"
+            <<header.sampleRatio<<", which does not match this one"<<endl;
+        return false;
+    }
+
+    if( header.policy >= CRC_REPL_MAX )
+    {
+        cerr<<"checkpoint: "<<path<<" is corrupt"<<endl;
+        return false;
+    }
+
+    COUNTER counters[2];
+
+    if( !cache->Restore( &ckpt )
+        || !ckpt.Read( CKPT_CACHE_STATS, stats, threads * sizeof(CRC_THREAD_STATS) )
+        || !ckpt.Read( CKPT_CACHE_COUNTERS, counters, sizeof(counters) ) )
+    {
+        return false;
+    }
+
+    mytimer = counters[0];
+    skipped = counters[1];
+
+    if( sampledSet )
+    {
+        const char *saved = (const char *) ckpt.Section( CKPT_SAMPLE_STATS, SAMPLE_STATS * numsets * sizeof(COUNTER) );
+
+        if( saved == NULL ) return false;
+        for(UINT32 i=0; i<SAMPLE_STATS; i++)
+        {
+            memcpy( setStats[i], saved + (size_t) i * numsets * sizeof(COUNTER), numsets * sizeof(COUNTER) );
+        }
+    }
+
+    if( header.policy != replPolicy )
+    {
+        cerr<<"checkpoint: "<<path<<" holds "<<crc_repl_names[ header.policy ]
+            <<" state, starting "<<crc_repl_names[ replPolicy ]<<" from warm tags only"<<endl;
+        return true;
+    }
+
+    return cacheReplState->Restore( &ckpt );
+}
 
-    // Find Tag
-    for(UINT32 way=0; way<assoc; way++) 
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Interval snapshots. The counters are registered once, so a snapshot only   //
+// copies them; the writer thread formats the rows.                           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_CACHE::RegisterStats()
+{
+    for(UINT32 t=0; t<threads; t++)
     {
-        if( currSet[way].valid && (currSet[way].tag == tag) ) 
+        for(UINT32 a=0; a<ACCESS_MAX; a++)
         {
-            return way;
+            if( a == ACCESS_UNSUPPORT0 || a == ACCESS_UNSUPPORT1 ) continue;
+
+            ostringstream prefix;
+            string        name = crc_access_names[a];
+
+            name.erase( name.find_last_not_of( ' ' ) + 1 );
+            prefix<<"t"<<t<<"."<<name<<".";
+
+            registry.Register( prefix.str() + "lookups", &stats[t].lookups[a] );
+            registry.Register( prefix.str() + "misses",  &stats[t].misses[a] );
+            registry.Register( prefix.str() + "hits",    &stats[t].hits[a] );
         }
     }
 
-    // If not found, return -1
-    return -1;
+    if( sampledSet ) registry.Register( "skipped", &skipped );
+
+    cacheReplState->RegisterStats( &registry );
+}
+
+bool CRC_CACHE::OpenSnapshots( const char *path, COUNTER interval )
+{
+    assert( !shared && snapshots == NULL && registry.Size() == 0 );
+
+    RegisterStats();
+
+    snapshots = new CRC_STATS_WRITER;
+    if( !snapshots->Open( path, CRC_STATS_WRITER::FormatOf( path ), registry ) )
+    {
+        delete snapshots;
+        snapshots = NULL;
+        return false;
+    }
+
+    snapshotInterval = interval;
+    nextSnapshot     = interval ? mytimer + interval : ~(COUNTER) 0;
+
+    return true;
+}
+
+void CRC_CACHE::TakeSnapshot()
+{
+    snapshots->Push( mytimer, registry );
+
+    lastSnapshot  = mytimer;
+    nextSnapshot += snapshotInterval;
+}
+
+bool CRC_CACHE::CloseSnapshots()
+{
+    if( snapshots == NULL ) return true;
+
+    if( mytimer != lastSnapshot ) snapshots->Push( mytimer, registry );
+
+    bool ok = snapshots->Close();
+
+    delete snapshots;
+    snapshots    = NULL;
+    nextSnapshot = ~(COUNTER) 0;
+
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function slects a victim for the given set index. We enforce that      //
+// we first fill all invalid entries. Once all invalid entries are filled     //
+// the replacement policy is consulted to find the victim                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+template <UINT32 POL>
+INT32 CRC_CACHE::GetVictimInSet( UINT32 tid, UINT32 setIndex, Addr_t PC, Addr_t paddr, UINT32 accessType ) 
+{
+    // First find and fill invalid lines
+    INT32 way = cache->FirstInvalid( setIndex );
+
+    if( way != -1 )
+    {
+        return way;
+    }
+
+    // If no invalid lines, then replace based on replacement policy
+    const LINE_STATE *vicSet = NULL;
+
+    if( lineStateViews )
+    {
+        LINE_STATE *view = victimSet + (size_t) tid * assoc;
+
+        cache->GetSet( setIndex, view );
+        vicSet = view;
+    }
+
+    if constexpr( POL == CRC_REPL_MAX )
+    {
+        return cacheReplState->GetVictimInSet( tid, setIndex, vicSet, assoc, PC, paddr, accessType );
+    }
+    else
+    {
+        return cacheReplState->GetVictimInSetT<POL>( tid, setIndex, vicSet, PC, paddr, accessType );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function hands a replacement state update to the policy, either        //
+// through the specialized entry point or through the runtime dispatch        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+template <UINT32 POL>
+void CRC_CACHE::UpdateReplacementState( UINT32 setIndex, INT32 wayID, const LINE_STATE *currLine,
+                                        UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType, bool hit )
+{
+    if constexpr( POL == CRC_REPL_MAX )
+    {
+        cacheReplState->UpdateReplacementState( setIndex, wayID, currLine, tid, PC, paddr, accessType, hit );
+    }
+    else
+    {
+        cacheReplState->UpdateReplacementStateT<POL>( setIndex, wayID, currLine, tid, PC, paddr, accessType, hit );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function looks up the set for the tag and returns physical way index   //
+// if the tag was a hit. Else returns -1 if it was a miss.                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+INT32 CRC_CACHE::LookupSet( UINT32 setIndex, Addr_t tag )
+{
+    // Find Tag, if not found returns -1
+    return cache->Lookup( setIndex, tag );
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -271,22 +582,46 @@ bool CRC_CACHE::CacheInspect( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 access
 // the result was a cache hit, the replacement policy again is consulted      //
 // to determine how to update the replacement state.                          //
 //                                                                            //
+// LookupAndFillCache calls the instance of this function that was selected   //
+// for the replacement policy at construction.                                //
+//                                                                            //
+// In shared mode the whole access holds the lock of its set. Everything it   //
+// touches is per set or per thread, except for what the replacement policy   //
+// keeps for the whole cache and protects itself.                             //
+//                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
-bool CRC_CACHE::LookupAndFillCache( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType ) 
+template <UINT32 POL, bool SHARED, bool WARMUP>
+bool CRC_CACHE::LookupAndFill( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType ) 
 {
 
-    LINE_STATE *currLine = NULL;
+    LINE_STATE currLine;
+
+    UINT32 setIndex = GetSetIndex( paddr );  // Get the set index
+
+    // In sampled mode, accesses to unsampled sets are only counted
+    if( sampledSet && !sampledSet[ setIndex ] )
+    {
+        if constexpr( !WARMUP ) skipped++;
+        return false;
+    }
 
-    // for modeling LRU
-    ++mytimer;     
-    cacheReplState->IncrementTimer();
+    CRC_SPIN_GUARD guard( SHARED ? &setLocks[ setIndex & setLockMask ].lock : NULL );
+
+    // for modeling LRU; cache-wide counters, so not kept in shared mode
+    // (nor during warmup)
+    if constexpr( !SHARED && !WARMUP )
+    {
+        if( mytimer == nextSnapshot ) TakeSnapshot();
+
+        ++mytimer;     
+        cacheReplState->IncrementTimer();
+    }
 
     // manage stats for cache
-    lookups[ accessType ][ tid ]++;
+    if constexpr( !WARMUP ) stats[ tid ].lookups[ accessType ]++;
 
     // Process request
     bool  hit       = true;
-    UINT32 setIndex = GetSetIndex( paddr );  // Get the set index
     Addr_t tag      = GetTag( paddr );       // Determine Cache Tag
 
     // Lookup the cache set to determine whether line is already in cache or not
@@ -298,48 +633,190 @@ bool CRC_CACHE::LookupAndFillCache( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32
         hit = false;
 
         // get victim line to replace (wayID = -1, then bypass)
-        wayID     = GetVictimInSet( tid, setIndex, PC, paddr, accessType );
+        wayID     = GetVictimInSet<POL>( tid, setIndex, PC, paddr, accessType );
 
-        if( wayID != -1 )
+        if constexpr( CRC_INSTRUMENTED && !WARMUP )
         {
-            currLine  = &cache[ setIndex ][ wayID ];
+            instrument->Miss( setIndex, wayID, wayID != -1 && cache->Valid( setIndex, wayID ), PC );
+        }
 
+        if( wayID != -1 )
+        {
             // Update the line state accordingly
-            currLine->valid          = true;
-            currLine->tag            = tag;
-            currLine->dirty          = IS_STORE( accessType );
-            currLine->sharing_dir    = (1<<tid);
+            currLine.valid          = true;
+            currLine.tag            = tag;
+            currLine.dirty          = IS_STORE( accessType );
+            currLine.sharing_dir    = (1ULL << tid);
+
+            if constexpr( WARMUP ) cache->FillTag( setIndex, wayID, currLine.tag, currLine.dirty );
+            else                   cache->Fill( setIndex, wayID, currLine.tag, currLine.dirty, currLine.sharing_dir );
 
             // Update Replacement State
-            cacheReplState->UpdateReplacementState( setIndex, wayID, currLine, tid, PC, accessType, hit );
+            UpdateReplacementState<POL>( setIndex, wayID, lineStateViews ? &currLine : NULL,
+                                         tid, PC, paddr, accessType, hit );
         }
         
         // Update Stats
-        misses[ accessType ][ tid ]++;
+        if constexpr( !WARMUP )
+        {
+            stats[ tid ].misses[ accessType ]++;
+
+            if( sampledSet ) CountSampled( setIndex, accessType, true );
+        }
     }
     else 
     {
-        // get pointer to cache line we hit
-        currLine         = &cache[ setIndex ][ wayID ];
-
         // Update the line state accordingly
-        currLine->dirty         |= IS_STORE( accessType );
-        currLine->sharing_dir   |= (1<<tid);
+        bool isStore = IS_STORE( accessType );
+        if constexpr( WARMUP ) cache->TouchDirty( setIndex, wayID, isStore );
+        else                   cache->Touch( setIndex, wayID, isStore, (1ULL << tid) );
+
+        if constexpr( CRC_INSTRUMENTED && !WARMUP ) instrument->Hit( setIndex, wayID, PC );
 
         // Update Replacement State
-        if( accessType != ACCESS_WRITEBACK ) 
+        if( accessType != ACCESS_WRITEBACK || writebackUpdates ) 
         {
-            cacheReplState->UpdateReplacementState( setIndex, wayID, currLine, tid, PC, accessType, hit );
+            if( lineStateViews ) cache->GetLine( setIndex, wayID, &currLine );
+            UpdateReplacementState<POL>( setIndex, wayID, lineStateViews ? &currLine : NULL,
+                                         tid, PC, paddr, accessType, hit );
         }
 
         // Update Stats
-        hits[ accessType ][ tid ]++;
+        if constexpr( !WARMUP )
+        {
+            stats[ tid ].hits[ accessType ]++;
+
+            if( sampledSet ) CountSampled( setIndex, accessType, false );
+        }
     }        
 
     return hit;
 }
 
 
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Batched lookups. The set of the access CRC_PREFETCH_DISTANCE ahead is      //
+// prefetched before every access, so that with a modeled cache much larger   //
+// than the host caches several sets are in flight at once. Prefetching has   //
+// no effect on the simulation; the accesses are handled one after the other  //
+// exactly as by LookupAndFillCache.                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+template <UINT32 POL>
+void CRC_CACHE::PrefetchSet( UINT32 setIndex )
+{
+    // Accesses to unsampled sets never reach the set
+    if( sampledSet && !sampledSet[ setIndex ] ) return;
+
+    cache->PrefetchSet( setIndex );
+
+    if constexpr( POL == CRC_REPL_MAX )
+    {
+        cacheReplState->PrefetchSet( setIndex );
+    }
+    else
+    {
+        cacheReplState->PrefetchSetT<POL>( setIndex );
+    }
+}
+
+template <UINT32 POL, bool SHARED, bool WARMUP>
+UINT32 CRC_CACHE::LookupAndFillBatchT( const TRACE_RECORD *recs, UINT32 n, bool *hit )
+{
+    UINT32 hits  = 0;
+    UINT32 ahead = (n < CRC_PREFETCH_DISTANCE) ? n : CRC_PREFETCH_DISTANCE;
+
+    for(UINT32 i=0; i<ahead; i++) PrefetchSet<POL>( GetSetIndex( recs[i].paddr ) );
+
+    for(UINT32 i=0; i<n; i++)
+    {
+        if( i + CRC_PREFETCH_DISTANCE < n )
+        {
+            PrefetchSet<POL>( GetSetIndex( recs[ i + CRC_PREFETCH_DISTANCE ].paddr ) );
+        }
+
+        bool h = LookupAndFill<POL, SHARED, WARMUP>( recs[i].tid, recs[i].PC, recs[i].paddr, recs[i].accessType );
+
+        hits += h;
+        if( hit ) hit[i] = h;
+    }
+
+    return hits;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Warmup. The warmup paths hand whole runs of accesses to the stripped       //
+// lookup and only count them down per call; the access that ends the warmup  //
+// switches the lookup path and the rest of its batch takes the full one.     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+template <UINT32 POL>
+bool CRC_CACHE::WarmupLookup( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType )
+{
+    bool hit = LookupAndFill<POL, false, true>( tid, PC, paddr, accessType );
+
+    if( --warmupLeft == 0 ) EndWarmup();
+
+    return hit;
+}
+
+template <UINT32 POL>
+UINT32 CRC_CACHE::WarmupBatch( const TRACE_RECORD *recs, UINT32 n, bool *hit )
+{
+    UINT32 warm = (warmupLeft < n) ? (UINT32) warmupLeft : n;
+    UINT32 hits = LookupAndFillBatchT<POL, false, true>( recs, warm, hit );
+
+    warmupLeft -= warm;
+    if( warmupLeft == 0 )
+    {
+        EndWarmup();
+        if( warm < n ) hits += LookupAndFillBatch( recs + warm, n - warm, hit ? hit + warm : NULL );
+    }
+
+    return hits;
+}
+
+void CRC_CACHE::BeginWarmup( COUNTER accesses )
+{
+    assert( !shared );
+
+    warmupLeft = accesses;
+    UseRuntimeDispatch( runtimeDispatch );
+}
+
+void CRC_CACHE::EndWarmup()
+{
+    warmupLeft = 0;
+    ResetStats();
+    UseRuntimeDispatch( runtimeDispatch );
+}
+
+void CRC_CACHE::ResetStats()
+{
+    for(UINT32 t=0; t<threads; t++)
+    {
+        for(UINT32 i=0; i<ACCESS_MAX; i++)
+        {
+            stats[t].lookups[i] = 0;
+            stats[t].misses[i]  = 0;
+            stats[t].hits[i]    = 0;
+        }
+    }
+
+    skipped = 0;
+    if( sampledSet )
+    {
+        for(UINT32 i=0; i<SAMPLE_STATS; i++)
+        {
+            for(UINT32 s=0; s<numsets; s++) setStats[i][s] = 0;
+        }
+    }
+
+    cacheReplState->ResetStats();
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 // This function is responsible for creating the cache replacement state      //
@@ -347,5 +824,230 @@ bool CRC_CACHE::LookupAndFillCache( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32
 ////////////////////////////////////////////////////////////////////////////////
 void CRC_CACHE::InitCacheReplacementState()
 {
-    cacheReplState = new CACHE_REPLACEMENT_STATE( numsets, assoc, replPolicy );
+    cacheReplState = new CACHE_REPLACEMENT_STATE( numsets, assoc, replPolicy, &arena );
+    cacheReplState->SetThreads( threads );
+    lineStateViews   = cacheReplState->UsesLineState();
+    writebackUpdates = cacheReplState->UpdatesOnWriteback();
+
+    UseRuntimeDispatch( false );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function selects the lookup path: the one specialized for the          //
+// replacement policy, or the generic one that dispatches on replPolicy at    //
+// every access                                                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_CACHE::UseRuntimeDispatch( bool runtime )
+{
+    runtimeDispatch = runtime;
+
+    if( runtime )
+    {
+        SelectLookup<CRC_REPL_MAX>();
+        return;
+    }
+
+    switch( replPolicy )
+    {
+#define CRC_REPL_CASE( P ) case P: SelectLookup<P>(); break;
+        CRC_REPL_FOR_EACH_POLICY( CRC_REPL_CASE )
+#undef CRC_REPL_CASE
+    }
+}
+
+template <UINT32 POL>
+void CRC_CACHE::SelectLookup()
+{
+    if( shared )
+    {
+        lookupAndFill      = &CRC_CACHE::LookupAndFill<POL, true>;
+        lookupAndFillBatch = &CRC_CACHE::LookupAndFillBatchT<POL, true>;
+    }
+    else if( warmupLeft )
+    {
+        lookupAndFill      = &CRC_CACHE::WarmupLookup<POL>;
+        lookupAndFillBatch = &CRC_CACHE::WarmupBatch<POL>;
+    }
+    else
+    {
+        lookupAndFill      = &CRC_CACHE::LookupAndFill<POL, false>;
+        lookupAndFillBatch = &CRC_CACHE::LookupAndFillBatchT<POL, false>;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function switches the cache to shared mode (see crc_cache.h). The set  //
+// locks are padded to a cache line each, so there are at most CRC_SET_LOCKS  //
+// of them.                                                                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_CACHE::EnableSharedAccess()
+{
+    assert( mytimer == 0 && sampledSet == NULL && !shared && snapshots == NULL && warmupLeft == 0 );
+
+    UINT32 locks = (numsets < CRC_SET_LOCKS) ? numsets : CRC_SET_LOCKS;
+
+    setLocks    = new CRC_PADDED_SPIN_LOCK[ locks ];
+    setLockMask = locks - 1;
+    shared      = true;
+
+    cacheReplState->EnableSharedAccess();
+    if( instrument ) instrument->EnableSharedAccess();
+    UseRuntimeDispatch( runtimeDispatch );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Set sampling. Sets are picked by hashing the set index so that the sample  //
+// is spread evenly over the index space; the leader sets of set dueling are  //
+// always simulated in addition so that the policy selection keeps training.  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+static inline UINT32 SampleHash( UINT32 setIndex )
+{
+    // murmur3 finalizer
+    setIndex ^= setIndex >> 16;
+    setIndex *= 0x85ebca6b;
+    setIndex ^= setIndex >> 13;
+    setIndex *= 0xc2b2ae35;
+    setIndex ^= setIndex >> 16;
+
+    return setIndex;
+}
+
+void CRC_CACHE::EnableSetSampling( UINT32 ratio )
+{
+    // Sampling must be chosen before the first access, and skips accesses
+    // with a cache-wide count
+    assert( mytimer == 0 && sampledSet == NULL && !shared );
+
+    if( ratio <= 1 ) return;
+
+    sampleRatio = ratio;
+    sampledSet  = arena.Alloc<unsigned char>( numsets );
+
+    for(UINT32 s=0; s<numsets; s++)
+    {
+        sampledSet[s] = (SampleHash( s ) % ratio == 0) || cacheReplState->IsLeaderSet( s );
+    }
+
+    for(UINT32 i=0; i<SAMPLE_STATS; i++)
+    {
+        setStats[i] = arena.Alloc<COUNTER>( numsets );     // zero
+    }
+}
+
+void CRC_CACHE::CountSampled( UINT32 setIndex, UINT32 accessType, bool miss )
+{
+    setStats[ SAMPLE_LOOKUPS ][ setIndex ]++;
+    setStats[ SAMPLE_MISSES ][ setIndex ] += miss;
+
+    if( accessType <= ACCESS_STORE )
+    {
+        setStats[ SAMPLE_DEMAND_LOOKUPS ][ setIndex ]++;
+        setStats[ SAMPLE_DEMAND_MISSES ][ setIndex ] += miss;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function estimates the miss rate of the whole cache from the sampled   //
+// sets. The leader sets form a stratum that is simulated completely, the     //
+// other sets are a sample of the followers; the miss and lookup totals are   //
+// extrapolated per stratum and their ratio is the estimate. The 95%          //
+// confidence half-width comes from the linearized variance of the ratio      //
+// estimator over the sampled followers, with finite population correction.   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_CACHE::EstimateMissRate( const COUNTER *setLookups, const COUNTER *setMisses,
+                                  double *rate, double *halfWidth )
+{
+    double leaderLookups = 0, leaderMisses = 0;
+    double sampleLookups = 0, sampleMisses = 0;
+    UINT32 followers = 0, sampled = 0;
+
+    for(UINT32 s=0; s<numsets; s++)
+    {
+        if( cacheReplState->IsLeaderSet( s ) )
+        {
+            leaderLookups += setLookups[s];
+            leaderMisses  += setMisses[s];
+            continue;
+        }
+
+        followers++;
+
+        if( sampledSet[s] )
+        {
+            sampled++;
+            sampleLookups += setLookups[s];
+            sampleMisses  += setMisses[s];
+        }
+    }
+
+    double scale   = sampled ? (double) followers / sampled : 0.0;
+    double lookups = leaderLookups + scale * sampleLookups;
+    double misses  = leaderMisses + scale * sampleMisses;
+
+    *rate      = lookups ? misses / lookups : 0.0;
+    *halfWidth = 0.0;
+
+    if( sampled < 2 || lookups == 0 ) return;
+
+    // Sample variance of the residuals misses - rate * lookups
+    double sum = 0, sumSq = 0;
+
+    for(UINT32 s=0; s<numsets; s++)
+    {
+        if( !sampledSet[s] || cacheReplState->IsLeaderSet( s ) ) continue;
+
+        double d = setMisses[s] - *rate * setLookups[s];
+        sum   += d;
+        sumSq += d * d;
+    }
+
+    double variance = (sumSq - sum * sum / sampled) / (sampled - 1);
+    double fpc      = 1.0 - (double) sampled / followers;
+    double varTotal = (double) followers * followers * fpc * variance / sampled;
+
+    *halfWidth = 1.96 * sqrt( varTotal ) / lookups;
+}
+
+bool CRC_CACHE::SampledMissRate( bool demand, double *rate, double *halfWidth )
+{
+    if( sampledSet == NULL ) return false;
+
+    if( demand ) EstimateMissRate( setStats[ SAMPLE_DEMAND_LOOKUPS ], setStats[ SAMPLE_DEMAND_MISSES ], rate, halfWidth );
+    else         EstimateMissRate( setStats[ SAMPLE_LOOKUPS ], setStats[ SAMPLE_MISSES ], rate, halfWidth );
+
+    return true;
+}
+
+ostream & CRC_CACHE::PrintSamplingStats( ostream &out )
+{
+    UINT32 sampled = 0, leaders = 0;
+
+    for(UINT32 s=0; s<numsets; s++)
+    {
+        sampled += sampledSet[s];
+        leaders += cacheReplState->IsLeaderSet( s );
+    }
+
+    double rate, halfWidth, demandRate, demandHalfWidth;
+
+    SampledMissRate( false, &rate, &halfWidth );
+    SampledMissRate( true, &demandRate, &demandHalfWidth );
+
+    out<<"Set Sampling: "<<endl;
+    out<<"	Sampled Sets:   "<<sampled<<" of "<<numsets<<" (1 in "<<sampleRatio
+       <<", "<<leaders<<" leader sets)"<<endl;
+    out<<"	Skipped Accesses: "<<skipped<<endl;
+    out<<"	Est. Miss Rate:        "<<rate*100.0<<" +- "<<halfWidth*100.0<<" (95% CI)"<<endl;
+    out<<"	Est. Demand Miss Rate: "<<demandRate*100.0<<" +- "<<demandHalfWidth*100.0<<" (95% CI)"<<endl;
+    out<<endl;
+
+    return out;
 }
@@ -27,6 +27,41 @@
 #include "utils.h"
 #include "replacement_state.h"
 #include "crc_cache_defs.h"
+#include "tag_store.h"
+#include "spin_lock.h"
+#include "trace.h"
+#include "instrument.h"
+#include "stats_registry.h"
+#include "checkpoint.h"
+#include "arena.h"
+
+extern string crc_access_names[ ACCESS_MAX ];
+
+// Most set locks of a shared cache; the sets of bigger caches share locks
+#define CRC_SET_LOCKS  4096
+
+// Most threads of a cache: the sharing directory of a line has a bit per
+// thread, as do the per-thread policy structures (SHiP, set dueling)
+#define CRC_MAX_THREADS  32
+
+// Access counts of one thread, a cache line apart from the other threads'
+// so that the threads of a shared cache do not write to the same line
+struct alignas(CRC_CACHE_LINE) CRC_THREAD_STATS
+{
+    COUNTER lookups[ ACCESS_MAX ];
+    COUNTER misses[ ACCESS_MAX ];
+    COUNTER hits[ ACCESS_MAX ];
+};
+
+// Per-set statistics kept for sampled simulation
+enum SampleStats
+{
+    SAMPLE_LOOKUPS         = 0,
+    SAMPLE_MISSES          = 1,
+    SAMPLE_DEMAND_LOOKUPS  = 2,
+    SAMPLE_DEMAND_MISSES   = 3,
+    SAMPLE_STATS           = 4
+};
 
 class CRC_CACHE
 {
@@ -38,14 +73,22 @@ class CRC_CACHE
     UINT32 threads;
     UINT32 linesize;
     UINT32 replPolicy;
-    
-    LINE_STATE               **cache;
+
+    // All per-set state (tags, replacement state, statistics) is allocated
+    // from one arena and freed with it
+    CRC_ARENA                 arena;
+
+    CRC_TAG_STORE            *cache;
     CACHE_REPLACEMENT_STATE  *cacheReplState;
+    LINE_STATE               *victimSet;      // LINE_STATE view of a set for victim selection, per thread
+    bool                      lineStateViews; // build LINE_STATE views for the policy?
+    bool                      writebackUpdates; // does the policy see writeback hits?
+
+    // statistics, one block per thread
+    CRC_THREAD_STATS *stats;
 
-    // statistics
-    COUNTER *lookups[ ACCESS_MAX ];
-    COUNTER *misses[ ACCESS_MAX ];
-    COUNTER *hits[ ACCESS_MAX ];
+    // Access path instrumentation (instrument.h), NULL unless compiled in
+    CRC_INSTRUMENT   *instrument;
 
     // Lookup Parameters
     UINT32 lineShift;
@@ -53,15 +96,131 @@ class CRC_CACHE
     UINT32 indexMask;
 
     COUNTER mytimer; 
+
+    // Interval snapshots of the registered counters (stats_registry.h),
+    // taken when mytimer reaches nextSnapshot
+    CRC_STATS_REGISTRY  registry;
+    CRC_STATS_WRITER   *snapshots;
+    COUNTER             snapshotInterval;
+    COUNTER             nextSnapshot;
+    COUNTER             lastSnapshot;
+
+    // Set sampling: per-set flag of the simulated sets (NULL when all are)
+    // and per-set lookup/miss counts of the sampled sets for the estimator
+    unsigned char *sampledSet;
+    UINT32         sampleRatio;
+    COUNTER        skipped;
+    COUNTER       *setStats[ SAMPLE_STATS ];
+
+    // Accesses left to the warmup path (BeginWarmup), 0 once measuring
+    COUNTER        warmupLeft;
+
+    // Shared mode: the lock of every set, striped when there are more sets
+    // than CRC_SET_LOCKS
+    bool                  shared;
+    CRC_PADDED_SPIN_LOCK *setLocks;
+    UINT32                setLockMask;
+
+    // Lookup path specialized for the replacement policy, picked at construction
+    typedef bool (CRC_CACHE::*LOOKUP_FN)( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType );
+    typedef UINT32 (CRC_CACHE::*BATCH_FN)( const TRACE_RECORD *recs, UINT32 n, bool *hit );
+    LOOKUP_FN lookupAndFill;
+    BATCH_FN  lookupAndFillBatch;
+    bool      runtimeDispatch;
     
   public:
 
     CRC_CACHE( UINT32 _cacheSize, UINT32 _assoc, UINT32 _tpc, UINT32 _linesize=64, UINT32 _pol=CRC_REPL_LRU );
+    ~CRC_CACHE();
 
     bool   CacheInspect( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType );
-    bool   LookupAndFillCache( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType );
+    bool   LookupAndFillCache( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType )
+    {
+        return (this->*lookupAndFill)( tid, PC, paddr, accessType );
+    }
+
+    // Looks up and fills n accesses in order, with exactly the effect of n
+    // LookupAndFillCache calls, while prefetching the tag store and
+    // replacement state of the access CRC_PREFETCH_DISTANCE ahead (see
+    // prefetch.h). Stores the outcome of every access in hit if given and
+    // returns the number of hits.
+    UINT32 LookupAndFillBatch( const TRACE_RECORD *recs, UINT32 n, bool *hit = NULL )
+    {
+        return (this->*lookupAndFillBatch)( recs, n, hit );
+    }
     ostream &   PrintStats(ostream &out);
 
+    // The statistics as one JSON object, including the instrumentation if
+    // it is compiled in
+    ostream &   PrintJSON(ostream &out);
+    CRC_INSTRUMENT * Instrumentation() { return instrument; }
+
+    // Write a snapshot of the counters of the cache and its replacement
+    // policy to path (CSV for .csv files, JSON lines otherwise) every
+    // interval simulated accesses, or only at the end for 0. The rows are
+    // formatted on a background thread. Call after configuring the policy
+    // (and restoring a checkpoint) and before the first access; not
+    // available in shared mode.
+    bool   OpenSnapshots( const char *path, COUNTER interval );
+
+    // Write the final snapshot and close the file; false on write errors
+    bool   CloseSnapshots();
+
+    const CRC_STATS_REGISTRY & Statistics() const { return registry; }
+
+    // Functional warmup: the next accesses accesses only update the tags
+    // (without sharer bits) and the replacement state, skipping statistics,
+    // timers, snapshots and instrumentation. The cache then switches to the
+    // full path, with the statistics of the cache and the policy reset, in
+    // the middle of a batch if need be. EndWarmup switches early. Not
+    // available in shared mode.
+    void   BeginWarmup( COUNTER accesses );
+    void   EndWarmup();
+    bool   InWarmup() const { return warmupLeft != 0; }
+
+    // Zero the statistics of the cache and its replacement policy; the
+    // cache and policy state are left alone
+    void   ResetStats();
+
+    // Write the tags, statistics and replacement state to a checkpoint file
+    // (checkpoint.h), and read one back into a cache of the same geometry,
+    // threads and set sampling, after configuring the policy and before the
+    // first access. A checkpoint of another policy restores the tags and
+    // statistics only, so one warmed cache can start runs of every policy.
+    // A failed restore leaves the cache unusable. Neither works for OPT or
+    // in shared mode.
+    bool   SaveCheckpoint( const char *path );
+    bool   RestoreCheckpoint( const char *path );
+
+    CACHE_REPLACEMENT_STATE * ReplacementState() { return cacheReplState; }
+
+    // Move the arena to the NUMA node of the calling thread (arena.h); the
+    // simulation workers call this before their first access
+    void   MoveToLocalNode() { arena.MoveToLocalNode(); }
+    const CRC_ARENA & Arena() const { return arena; }
+
+    // Use the policy-generic lookup path instead of the specialized one
+    // (same results, used to measure what specialization buys)
+    void   UseRuntimeDispatch( bool runtime );
+
+    // Simulate only about one in ratio sets (plus any set-dueling leader
+    // sets) and skip the accesses to the others, which LookupAndFillCache
+    // reports as misses. PrintStats then adds miss rates extrapolated to the
+    // whole cache with 95% confidence intervals. Call before the first access.
+    void   EnableSetSampling( UINT32 ratio );
+
+    // Extrapolated miss rate (all or demand accesses) and its 95% confidence
+    // half-width; false if the cache is not sampled
+    bool   SampledMissRate( bool demand, double *rate, double *halfWidth );
+
+    // Let several threads call LookupAndFillCache at once, as long as every
+    // tid is only issued by one of them. Each access holds the lock of its
+    // set, the statistics are per thread and the replacement policy guards
+    // its cache-wide state (CACHE_REPLACEMENT_STATE::EnableSharedAccess).
+    // The access timers are not advanced. Cannot be combined with set
+    // sampling or OPT; call before the first access.
+    void   EnableSharedAccess();
+
   private:
 
     Addr_t GetTag( Addr_t addr ) { return ((addr >> lineShift) >> indexShift); }
@@ -71,9 +230,38 @@ class CRC_CACHE
     void   InitCacheReplacementState();
 
     void   InitStats();
+    void   RegisterStats();
+    void   TakeSnapshot();
+
+    void   CountSampled( UINT32 setIndex, UINT32 accessType, bool miss );
+    void   EstimateMissRate( const COUNTER *setLookups, const COUNTER *setMisses,
+                             double *rate, double *halfWidth );
+    ostream &   PrintSamplingStats( ostream &out );
 
     INT32  LookupSet( UINT32 setIndex, Addr_t tag );
+
+    // POL is the replacement policy, or CRC_REPL_MAX to dispatch on replPolicy;
+    // SHARED takes the set lock; WARMUP only updates tags and replacement state
+    template <UINT32 POL, bool SHARED, bool WARMUP = false>
+    bool   LookupAndFill( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType );
+    template <UINT32 POL, bool SHARED, bool WARMUP = false>
+    UINT32 LookupAndFillBatchT( const TRACE_RECORD *recs, UINT32 n, bool *hit );
+
+    // Lookup paths while warming up: count down warmupLeft and switch to the
+    // full path when it runs out
+    template <UINT32 POL>
+    bool   WarmupLookup( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType );
+    template <UINT32 POL>
+    UINT32 WarmupBatch( const TRACE_RECORD *recs, UINT32 n, bool *hit );
+    template <UINT32 POL>
+    void   PrefetchSet( UINT32 setIndex );
+    template <UINT32 POL>
+    void   SelectLookup();
+    template <UINT32 POL>
     INT32  GetVictimInSet( UINT32 tid, UINT32 setIndex, Addr_t PC, Addr_t paddr, UINT32 accessType );
+    template <UINT32 POL>
+    void   UpdateReplacementState( UINT32 setIndex, INT32 wayID, const LINE_STATE *currLine,
+                                   UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType, bool hit );
 
   public:
 
@@ -81,24 +269,32 @@ class CRC_CACHE
     COUNTER ThreadDemandLookupStats( UINT32 tid )
     {
         COUNTER stat = 0;
-        for(UINT32 a=0; a<=ACCESS_STORE; a++) stat  += lookups[a][tid];
+        for(UINT32 a=0; a<=ACCESS_STORE; a++) stat  += stats[tid].lookups[a];
         return stat;
     }
 
     COUNTER ThreadDemandMissStats( UINT32 tid )
     {
         COUNTER stat = 0;
-        for(UINT32 a=0; a<=ACCESS_STORE; a++) stat  += misses[a][tid];
+        for(UINT32 a=0; a<=ACCESS_STORE; a++) stat  += stats[tid].misses[a];
         return stat;
     }
     
     COUNTER ThreadDemandHitStats( UINT32 tid )
     {
         COUNTER stat = 0;
-        for(UINT32 a=0; a<=ACCESS_STORE; a++) stat  += hits[a][tid];
+        for(UINT32 a=0; a<=ACCESS_STORE; a++) stat  += stats[tid].hits[a];
         return stat;
     }
 
+    COUNTER LookupStats( UINT32 accessType, UINT32 tid ) { return stats[tid].lookups[accessType]; }
+    COUNTER MissStats( UINT32 accessType, UINT32 tid )   { return stats[tid].misses[accessType]; }
+    COUNTER HitStats( UINT32 accessType, UINT32 tid )    { return stats[tid].hits[accessType]; }
+
+  private:
+
+    CRC_CACHE( const CRC_CACHE & );
+    CRC_CACHE & operator=( const CRC_CACHE & );
 };
 
 #endif
@@ -0,0 +1,62 @@
+#ifndef CRC_RANDOM_H
+#define CRC_RANDOM_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Small seeded pseudo-random generator (xorshift64*) for the randomized      //
+// replacement decisions. Every replacement state owns one, so runs are       //
+// reproducible for a given seed on any platform and caches simulated side    //
+// by side (sweeps, parallel shards) do not share or lock a stream.           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "utils.h"
+
+#define CRC_RANDOM_DEFAULT_SEED   0x2545f4914f6cdd1dULL
+
+class CRC_RANDOM
+{
+  private:
+
+    BITVECTOR   state;
+
+  public:
+
+    CRC_RANDOM( BITVECTOR seed = CRC_RANDOM_DEFAULT_SEED ) { Seed( seed ); }
+
+    // Any seed is fine: it is scrambled so that nearby seeds give unrelated
+    // streams, and the all-zero state is avoided
+    void        Seed( BITVECTOR seed )
+    {
+        seed  = Mix( seed );
+        state = seed ? seed : CRC_RANDOM_DEFAULT_SEED;
+    }
+
+    // splitmix64: a well-spread 64-bit value for every key, for decisions
+    // that must not depend on the order in which a stream is drawn from
+    static BITVECTOR Mix( BITVECTOR key )
+    {
+        key += 0x9e3779b97f4a7c15ULL;
+        key  = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        key  = (key ^ (key >> 27)) * 0x94d049bb133111ebULL;
+        return key ^ (key >> 31);
+    }
+
+    BITVECTOR   Next()
+    {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545f4914f6cdd1dULL;
+    }
+
+    // Uniform in [0, n), from the high bits by multiply-shift instead of a
+    // division
+    UINT32      Below( UINT32 n )
+    {
+        return (UINT32) (((Next() >> 32) * n) >> 32);
+    }
+};
+
+#endif
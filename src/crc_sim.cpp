@@ -0,0 +1,748 @@
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Standalone trace-driven driver for CRC_CACHE. Replays a raw (trace.h) or   //
+// compressed (trace_compress.h) trace through a single LLC model and prints  //
+// the cache statistics.                                                      //
+//                                                                            //
+// Comma-separated lists of sizes, associativities and policies select a      //
+// sweep: every combination is simulated in a single pass over the trace      //
+// (sweep_sim.h) and the results are printed as one table.                    //
+//                                                                            //
+// The OPT policy reads the next use of every access from an index built      //
+// from the trace beforehand (next_use.h).                                    //
+//                                                                            //
+// With -c the trace threads are replayed concurrently into one shared cache  //
+// by producer threads (shared_sim.h).                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <fstream>
+
+#include "crc_cache.h"
+#include "parallel_sim.h"
+#include "shared_sim.h"
+#include "sweep_sim.h"
+#include "next_use.h"
+#include "trace.h"
+#include "tag_match.h"
+
+static void Usage( const char *prog )
+{
+    cerr<<"usage: "<<prog<<" [options] <trace>"<<endl;
+    cerr<<"  -s <size>      cache size in bytes, K/M/G suffixes allowed (default 4M)"<<endl;
+    cerr<<"  -a <assoc>     associativity (default 16)"<<endl;
+    cerr<<"  -l <linesize>  line size in bytes (default 64)"<<endl;
+    cerr<<"  -p <policy>    replacement policy (default lru):"<<endl;
+    for(UINT32 p=0, column=80; p<CRC_REPL_MAX; p++)
+    {
+        if( column + 1 + crc_repl_names[p].size() > 78 )
+        {
+            if( p ) cerr<<endl;
+            cerr<<"                ";
+            column = 16;
+        }
+        cerr<<" "<<crc_repl_names[p];
+        column += 1 + crc_repl_names[p].size();
+    }
+    cerr<<endl;
+    cerr<<"  -t <threads>   number of threads (default taken from the trace)"<<endl;
+    cerr<<"  -j <workers>   simulate with this many set-partitioned worker threads"<<endl;
+    cerr<<"                 (power of two, default 1 = serial); in a sweep the number"<<endl;
+    cerr<<"                 of threads the configurations are spread over"<<endl;
+    cerr<<"  -c <producers> replay the trace threads concurrently into one shared cache,"<<endl;
+    cerr<<"                 with this many producer threads (at most one per thread)"<<endl;
+    cerr<<"  -o             with -c, issue the accesses in trace order (deterministic)"<<endl;
+    cerr<<"  -S <ratio>     simulate only about one in ratio sets and extrapolate"<<endl;
+    cerr<<"  -O <index>     next-use index for OPT, built from the (raw) trace if missing"<<endl;
+    cerr<<"  -B             let OPT bypass lines that are reused later than all others"<<endl;
+    cerr<<"  -H <sig>[:<bits>[:<ctr>]]"<<endl;
+    cerr<<"                 SHiP signature (pc, mem or iseq), log2 of the table"<<endl;
+    cerr<<"                 entries and counter width (default pc:14:3)"<<endl;
+    cerr<<"  -T             one SHiP table per thread"<<endl;
+    cerr<<"  -D <leaders>[:<bits>]"<<endl;
+    cerr<<"                 set dueling leader sets per policy and PSEL width"<<endl;
+    cerr<<"                 (default 32:10)"<<endl;
+    cerr<<"  -R <seed>      seed of the random and bimodal policy decisions"<<endl;
+    cerr<<"  -b             bimodal insertion every 32nd fill of a set instead of at"<<endl;
+    cerr<<"                 random"<<endl;
+    cerr<<"  -E <file>      write counter snapshots to file, CSV for .csv, JSON lines"<<endl;
+    cerr<<"                 otherwise (not with sweeps, -j or -c)"<<endl;
+    cerr<<"  -I <accesses>  with -E, a snapshot every this many simulated accesses"<<endl;
+    cerr<<"                 (default only at the end)"<<endl;
+    cerr<<"  -W <accesses>  warm up on this many accesses without statistics, then"<<endl;
+    cerr<<"                 measure the rest of the trace (not with -c, OPT or -j"<<endl;
+    cerr<<"                 outside of sweeps)"<<endl;
+    cerr<<"  -r <file>      start from the cache state of a checkpoint"<<endl;
+    cerr<<"  -w <file>      write a checkpoint of the cache state at the end"<<endl;
+    cerr<<"                 (-r and -w not with sweeps, -j, -c or OPT)"<<endl;
+    cerr<<"  -J <file>      also write the statistics as JSON (not with sweeps or -j)"<<endl;
+    cerr<<"  -M <pages>     pages of the cache state: thp (transparent huge pages,"<<endl;
+    cerr<<"                 default), hugetlb (the hugetlbfs pool) or small"<<endl;
+    cerr<<"  -v             in a sweep, also print the full statistics of every"<<endl;
+    cerr<<"                 configuration"<<endl;
+    cerr<<"-s, -a and -p take comma-separated lists; all combinations are swept"<<endl;
+    exit(1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Command line helpers                                                       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+static UINT32 ParseSize( const char *arg )
+{
+    char *end;
+    unsigned long long size = strtoull( arg, &end, 0 );
+
+    if( *end == 'k' || *end == 'K' ) { size <<= 10; end++; }
+    else if( *end == 'm' || *end == 'M' ) { size <<= 20; end++; }
+    else if( *end == 'g' || *end == 'G' ) { size <<= 30; end++; }
+
+    if( *end != '\0' || size == 0 || size > 0xffffffffULL )
+    {
+        cerr<<"bad size: "<<arg<<endl;
+        exit(1);
+    }
+
+    return (UINT32) size;
+}
+
+static UINT32 ParsePolicy( const char *arg )
+{
+    for(UINT32 p=0; p<CRC_REPL_MAX; p++)
+    {
+        if( strcasecmp( arg, crc_repl_names[p].c_str() ) == 0 ) return p;
+    }
+
+    // Allow "ship" as shorthand for SHIP-PC
+    if( strcasecmp( arg, "ship" ) == 0 ) return CRC_REPL_SHIPPC;
+
+    cerr<<"unknown replacement policy: "<<arg<<endl;
+    exit(1);
+}
+
+static ArenaPages ParsePages( const char *arg )
+{
+    ArenaPages pages;
+
+    if( CRC_ARENA::ParsePages( arg, &pages ) ) return pages;
+
+    cerr<<"unknown page size: "<<arg<<endl;
+    exit(1);
+}
+
+// Splits a comma-separated option argument and parses every element
+template <class PARSE>
+static vector<UINT32> ParseList( const char *arg, PARSE parse )
+{
+    vector<UINT32> values;
+    string         list( arg );
+    size_t         pos = 0;
+
+    while( true )
+    {
+        size_t comma = list.find( ',', pos );
+        string item  = list.substr( pos, comma == string::npos ? string::npos : comma - pos );
+
+        values.push_back( parse( item.c_str() ) );
+
+        if( comma == string::npos ) break;
+        pos = comma + 1;
+    }
+
+    return values;
+}
+
+static UINT32 ParseAssoc( const char *arg )
+{
+    return atoi( arg );
+}
+
+// SHiP predictor: <signature>[:<index bits>[:<counter bits>]]
+static void ParseSHiPConfig( const char *arg, SHIP_CONFIG *config )
+{
+    string spec( arg );
+    size_t colon = spec.find( ':' );
+    string sig   = spec.substr( 0, colon );
+    UINT32 s;
+
+    for(s=0; s<SHIP_SIG_MAX; s++)
+    {
+        if( strcasecmp( sig.c_str(), ship_sig_names[s].c_str() ) == 0 ) break;
+    }
+
+    config->source = s;
+
+    if( colon != string::npos )
+    {
+        char *end;
+
+        config->indexBits = strtoul( spec.c_str() + colon + 1, &end, 0 );
+        if( *end == ':' ) config->counterBits = strtoul( end + 1, &end, 0 );
+        if( *end != '\0' ) s = SHIP_SIG_MAX;
+    }
+
+    if( s == SHIP_SIG_MAX || config->indexBits < 1 || config->indexBits > 24
+        || config->counterBits < 1 || config->counterBits > 4 )
+    {
+        cerr<<"bad SHiP configuration: "<<arg<<endl;
+        exit(1);
+    }
+}
+
+// Policy parameters that are not part of the cache geometry
+typedef struct
+{
+    SHIP_CONFIG ship;
+    bool        shipTables;     // one SHiP table per thread
+    UINT32      duelLeaders;
+    UINT32      pselBits;
+    BITVECTOR   seed;
+    bool        bimodalThrottle;
+} POLICY_OPTIONS;
+
+// Set dueling: <leaders>[:<PSEL bits>]
+static void ParseDuelingConfig( const char *arg, POLICY_OPTIONS *options )
+{
+    char *end;
+
+    options->duelLeaders = strtoul( arg, &end, 0 );
+    if( *end == ':' ) options->pselBits = strtoul( end + 1, &end, 0 );
+
+    if( *end != '\0' || options->duelLeaders == 0 || (options->duelLeaders & (options->duelLeaders - 1)) != 0
+        || options->pselBits < 2 || options->pselBits > 31 )
+    {
+        cerr<<"bad set dueling configuration: "<<arg<<endl;
+        exit(1);
+    }
+}
+
+// -T gives every thread a SHiP table of its own; TraceThreads has already
+// turned away more threads than that
+static_assert( CRC_SHIP_MAX_THREADS >= CRC_MAX_THREADS, "a SHiP table per thread" );
+
+// Hands the policy parameters to a cache; each only applies to the policies
+// that use it
+static void ConfigurePolicy( CRC_CACHE *cache, const POLICY_OPTIONS &options, UINT32 threads )
+{
+    SHIP_CONFIG ship = options.ship;
+    ship.tables      = options.shipTables ? threads : 1;
+
+    cache->ReplacementState()->SetSHiPConfig( ship );
+    cache->ReplacementState()->SetDuelingConfig( options.duelLeaders, options.pselBits );
+    cache->ReplacementState()->SetSeed( options.seed );
+    cache->ReplacementState()->SetBimodalThrottle( options.bimodalThrottle );
+}
+
+static double Now()
+{
+    struct timeval tv;
+    gettimeofday( &tv, NULL );
+    return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static void ReportRate( COUNTER nrec, double elapsed )
+{
+    cerr<<"Simulated "<<nrec<<" accesses in "<<elapsed<<" s ("
+        <<(elapsed > 0 ? nrec / elapsed / 1e6 : 0)<<" M accesses/s, "
+        <<TagMatchName( SelectTagMatch() )<<" tag match)"<<endl;
+}
+
+// TA-DRRIP and TADIP duel in a group per thread: the thread limit checked
+// below must keep them within the groups SET_DUELING has room for
+static_assert( CRC_DUEL_MAX_GROUPS >= CRC_MAX_THREADS, "a set dueling group per thread" );
+
+// -t defaults to the threads of the trace and must cover all of them: the
+// thread of every access indexes per-thread state of the cache and policy,
+// which has room for CRC_MAX_THREADS
+static bool TraceThreads( const TRACE_SOURCE *trace, UINT32 *threads )
+{
+    if( *threads == 0 ) *threads = trace->NumThreads();
+    if( *threads == 0 ) *threads = 1;
+
+    if( *threads > CRC_MAX_THREADS )
+    {
+        cerr<<"at most "<<CRC_MAX_THREADS<<" threads are supported, not "<<*threads<<endl;
+        return false;
+    }
+
+    if( *threads < trace->NumThreads() )
+    {
+        cerr<<"-t "<<*threads<<" is fewer than the "<<trace->NumThreads()<<" threads of the trace"<<endl;
+        return false;
+    }
+
+    return true;
+}
+
+// The tag store holds up to CRC_TAG_STORE_MAXWAYS ways and the set index is
+// taken from the bits above a power-of-two line offset
+static bool CheckGeometry( UINT32 cacheSize, UINT32 assoc, UINT32 linesize )
+{
+    if( assoc == 0 || assoc > CRC_TAG_STORE_MAXWAYS )
+    {
+        cerr<<"-a must be between 1 and "<<CRC_TAG_STORE_MAXWAYS<<", not "<<assoc<<endl;
+        return false;
+    }
+    if( linesize == 0 || (linesize & (linesize - 1)) != 0 )
+    {
+        cerr<<"-l must be a power of two, not "<<linesize<<endl;
+        return false;
+    }
+    if( cacheSize / linesize < assoc )
+    {
+        cerr<<"-s "<<cacheSize<<" is less than one set of "<<assoc<<" lines of "<<linesize<<" bytes"<<endl;
+        return false;
+    }
+
+    return true;
+}
+
+// -J: the statistics of one cache as JSON, next to the text on stdout
+static bool WriteJSON( const char *path, CRC_CACHE *cache )
+{
+    if( path == NULL ) return true;
+
+    ofstream out( path );
+    if( !out )
+    {
+        cerr<<"cannot write "<<path<<endl;
+        return false;
+    }
+
+    cache->PrintJSON( out );
+
+    return out.good();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Sweep mode: one pass over the trace for every combination of the given     //
+// sizes, associativities and policies                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+static int Sweep( const char *path, const vector<UINT32> &sizes, const vector<UINT32> &assocs,
+                  const vector<UINT32> &policies, UINT32 linesize, UINT32 threads, UINT32 groups,
+                  UINT32 sampleRatio, COUNTER warmup, const POLICY_OPTIONS &options, bool verbose )
+{
+    vector<SWEEP_CONFIG> configs;
+
+    for(UINT32 s=0; s<sizes.size(); s++)
+    {
+        for(UINT32 a=0; a<assocs.size(); a++)
+        {
+            for(UINT32 p=0; p<policies.size(); p++)
+            {
+                SWEEP_CONFIG config = { sizes[s], assocs[a], linesize, policies[p] };
+                configs.push_back( config );
+            }
+        }
+    }
+
+    if( groups == 0 )
+    {
+        cerr<<"-j must be at least 1"<<endl;
+        return 1;
+    }
+
+    TRACE_SOURCE *trace = OpenTraceSource( path );
+    if( trace == NULL ) return 1;
+
+    if( !TraceThreads( trace, &threads ) )
+    {
+        delete trace;
+        return 1;
+    }
+
+    const TRACE_RECORD *rec;
+    UINT32              n;
+    COUNTER             nrec = 0;
+
+    CRC_SWEEP sweep( configs, threads, groups );
+
+    for(UINT32 c=0; c<sweep.NumConfigs(); c++)
+    {
+        ConfigurePolicy( sweep.Cache(c), options, threads );
+        sweep.Cache(c)->EnableSetSampling( sampleRatio );
+        if( warmup ) sweep.Cache(c)->BeginWarmup( warmup );
+    }
+
+    double start = Now();
+
+    while( (n = trace->NextBatch( &rec )) != 0 )
+    {
+        sweep.Access( rec, n );
+        nrec += n;
+    }
+    sweep.Finish();
+
+    if( trace->Failed() )
+    {
+        delete trace;
+        return 1;
+    }
+
+    double elapsed = Now() - start;
+
+    cerr<<"Swept "<<configs.size()<<" configurations on "<<sweep.NumGroups()<<" threads, ";
+    ReportRate( nrec * configs.size(), elapsed );
+    sweep.PrintStats( cout, verbose );
+
+    delete trace;
+
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// OPT: replay the trace and its next-use index in lockstep, handing the      //
+// next use of every access to the replacement state before the access        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+static int SimulateOPT( const char *path, const char *indexPath, UINT32 cacheSize, UINT32 assoc,
+                        UINT32 linesize, UINT32 threads, UINT32 sampling, bool bypass,
+                        const char *jsonPath, const char *snapshotPath, COUNTER interval )
+{
+    if( indexPath == NULL )
+    {
+        cerr<<"OPT needs a next-use index (-O)"<<endl;
+        return 1;
+    }
+
+    if( access( indexPath, R_OK ) != 0 )
+    {
+        cerr<<"Building next-use index "<<indexPath<<endl;
+        if( !BuildNextUseIndex( path, indexPath, linesize ) ) return 1;
+    }
+
+    NEXT_USE_READER index;
+    if( !index.Open( indexPath ) ) return 1;
+
+    TRACE_SOURCE *trace = OpenTraceSource( path );
+    if( trace == NULL ) return 1;
+
+    if( index.NumRecords() != trace->NumRecords() || index.LineSize() != linesize )
+    {
+        cerr<<"next-use index "<<indexPath<<" does not belong to this trace and line size"<<endl;
+        delete trace;
+        return 1;
+    }
+
+    if( !TraceThreads( trace, &threads ) )
+    {
+        delete trace;
+        return 1;
+    }
+
+    CRC_CACHE                cache( cacheSize, assoc, threads, linesize, CRC_REPL_OPT );
+    CACHE_REPLACEMENT_STATE *repl = cache.ReplacementState();
+
+    cache.EnableSetSampling( sampling );
+    repl->SetOPTBypass( bypass );
+
+    if( snapshotPath && !cache.OpenSnapshots( snapshotPath, interval ) )
+    {
+        delete trace;
+        return 1;
+    }
+
+    const TRACE_RECORD *rec;
+    UINT32              n;
+    COUNTER             nrec = 0;
+
+    double start = Now();
+
+    while( (n = trace->NextBatch( &rec )) != 0 )
+    {
+        for(UINT32 i=0; i<n; i++)
+        {
+            repl->SetNextUse( index.Next() );
+            cache.LookupAndFillCache( rec[i].tid, rec[i].PC, rec[i].paddr, rec[i].accessType );
+        }
+        nrec += n;
+    }
+
+    if( trace->Failed() || index.Failed() )
+    {
+        delete trace;
+        return 1;
+    }
+
+    double elapsed = Now() - start;
+
+    ReportRate( nrec, elapsed );
+    cache.PrintStats( cout );
+
+    delete trace;
+
+    bool ok = cache.CloseSnapshots();
+    ok      = WriteJSON( jsonPath, &cache ) && ok;
+
+    return ok ? 0 : 1;
+}
+
+int main( int argc, char **argv )
+{
+    vector<UINT32> sizes( 1, 4 << 20 );
+    vector<UINT32> assocs( 1, 16 );
+    vector<UINT32> policies( 1, CRC_REPL_LRU );
+    UINT32 linesize  = 64;
+    UINT32 threads   = 0;
+    UINT32 workers   = 1;
+    UINT32 producers = 0;
+    bool   ordered   = false;
+    UINT32 sampling  = 1;
+    char  *optIndex  = NULL;
+    bool   optBypass = false;
+    bool   verbose   = false;
+    char  *jsonPath  = NULL;
+    char  *snapshotPath = NULL;
+    COUNTER interval = 0;
+    char  *restorePath = NULL;
+    char  *savePath  = NULL;
+    COUNTER warmup   = 0;
+    int    opt;
+
+    POLICY_OPTIONS options;
+    options.ship            = DefaultSHiPConfig();
+    options.shipTables      = false;
+    options.duelLeaders     = 32;
+    options.pselBits        = 10;
+    options.seed            = CRC_RANDOM_DEFAULT_SEED;
+    options.bimodalThrottle = false;
+
+    while( (opt = getopt( argc, argv, "s:a:l:p:t:j:c:oS:O:BH:TD:R:bE:I:W:r:w:J:M:vh" )) != -1 )
+    {
+        switch( opt )
+        {
+            case 's': sizes     = ParseList( optarg, ParseSize ); break;
+            case 'a': assocs    = ParseList( optarg, ParseAssoc ); break;
+            case 'l': linesize  = atoi( optarg ); break;
+            case 'p': policies  = ParseList( optarg, ParsePolicy ); break;
+            case 't': threads   = atoi( optarg ); break;
+            case 'j': workers   = atoi( optarg ); break;
+            case 'c': producers = atoi( optarg ); break;
+            case 'o': ordered   = true; break;
+            case 'S': sampling  = atoi( optarg ); break;
+            case 'O': optIndex  = optarg; break;
+            case 'B': optBypass = true; break;
+            case 'H': ParseSHiPConfig( optarg, &options.ship ); break;
+            case 'T': options.shipTables = true; break;
+            case 'D': ParseDuelingConfig( optarg, &options ); break;
+            case 'R': options.seed = strtoull( optarg, NULL, 0 ); break;
+            case 'b': options.bimodalThrottle = true; break;
+            case 'E': snapshotPath = optarg; break;
+            case 'I': interval  = strtoull( optarg, NULL, 0 ); break;
+            case 'W': warmup    = strtoull( optarg, NULL, 0 ); break;
+            case 'r': restorePath = optarg; break;
+            case 'w': savePath  = optarg; break;
+            case 'J': jsonPath  = optarg; break;
+            case 'M': CRC_ARENA::SetPages( ParsePages( optarg ) ); break;
+            case 'v': verbose   = true; break;
+            default:  Usage( argv[0] );
+        }
+    }
+
+    if( optind != argc - 1 ) Usage( argv[0] );
+
+    for(UINT32 s=0; s<sizes.size(); s++)
+    {
+        for(UINT32 a=0; a<assocs.size(); a++)
+        {
+            if( !CheckGeometry( sizes[s], assocs[a], linesize ) ) return 1;
+        }
+    }
+
+    for(UINT32 p=0; p<policies.size(); p++)
+    {
+        if( policies[p] == CRC_REPL_OPT
+            && (policies.size() > 1 || sizes.size() * assocs.size() > 1 || workers > 1 || producers) )
+        {
+            cerr<<"OPT can only be simulated on its own, without sweeps, -j or -c"<<endl;
+            return 1;
+        }
+    }
+
+    if( producers && (workers > 1 || sampling > 1 || sizes.size() * assocs.size() * policies.size() > 1) )
+    {
+        cerr<<"-c cannot be combined with sweeps, -j or -S"<<endl;
+        return 1;
+    }
+
+    if( jsonPath && (workers > 1 || sizes.size() * assocs.size() * policies.size() > 1) )
+    {
+        cerr<<"-J cannot be combined with sweeps or -j"<<endl;
+        return 1;
+    }
+
+    if( snapshotPath && (producers || workers > 1 || sizes.size() * assocs.size() * policies.size() > 1) )
+    {
+        cerr<<"-E cannot be combined with sweeps, -j or -c"<<endl;
+        return 1;
+    }
+
+    if( (restorePath || savePath)
+        && (producers || workers > 1 || sizes.size() * assocs.size() * policies.size() > 1
+            || policies[0] == CRC_REPL_OPT) )
+    {
+        cerr<<"-r and -w cannot be combined with sweeps, -j, -c or OPT"<<endl;
+        return 1;
+    }
+
+    bool anyOPT = false;
+    for(UINT32 p=0; p<policies.size(); p++) anyOPT = anyOPT || policies[p] == CRC_REPL_OPT;
+
+    if( warmup && (producers || anyOPT || (workers > 1 && sizes.size() * assocs.size() * policies.size() == 1)) )
+    {
+        cerr<<"-W cannot be combined with -c, OPT or -j outside of sweeps"<<endl;
+        return 1;
+    }
+
+    if( sizes.size() * assocs.size() * policies.size() > 1 )
+    {
+        return Sweep( argv[optind], sizes, assocs, policies, linesize, threads, workers, sampling,
+                      warmup, options, verbose );
+    }
+
+    UINT32 cacheSize = sizes[0];
+    UINT32 assoc     = assocs[0];
+    UINT32 policy    = policies[0];
+
+    if( workers == 0 || (workers & (workers - 1)) != 0
+        || workers > cacheSize / (linesize * assoc) )
+    {
+        cerr<<"-j must be a power of two no larger than the number of sets"<<endl;
+        return 1;
+    }
+
+    if( workers > 1 && sampling > 1 )
+    {
+        cerr<<"-S cannot be combined with set-partitioned workers"<<endl;
+        return 1;
+    }
+
+    if( policy == CRC_REPL_OPT )
+    {
+        return SimulateOPT( argv[optind], optIndex, cacheSize, assoc, linesize, threads,
+                            sampling, optBypass, jsonPath, snapshotPath, interval );
+    }
+
+    TRACE_SOURCE *trace = OpenTraceSource( argv[optind] );
+    if( trace == NULL ) return 1;
+
+    if( !TraceThreads( trace, &threads ) )
+    {
+        delete trace;
+        return 1;
+    }
+
+    // Replay the trace batch by batch, records are used in place
+    const TRACE_RECORD *rec;
+    UINT32              n;
+    COUNTER             nrec = 0;
+    double              start, elapsed;
+
+    if( producers )
+    {
+        CRC_SHARED_CACHE cache( cacheSize, assoc, threads, producers, linesize, policy );
+        ConfigurePolicy( cache.Cache(), options, threads );
+
+        start = Now();
+
+        if( !cache.Replay( argv[optind], ordered ) )
+        {
+            delete trace;
+            return 1;
+        }
+        nrec = trace->NumRecords();
+
+        elapsed = Now() - start;
+        cerr<<"Shared cache, "<<cache.NumProducers()<<" producers"<<(ordered ? " in trace order" : "")<<", ";
+        ReportRate( nrec, elapsed );
+        cache.PrintStats( cout );
+
+        if( !WriteJSON( jsonPath, cache.Cache() ) )
+        {
+            delete trace;
+            return 1;
+        }
+    }
+    else if( workers == 1 )
+    {
+        CRC_CACHE cache( cacheSize, assoc, threads, linesize, policy );
+        ConfigurePolicy( &cache, options, threads );
+        cache.EnableSetSampling( sampling );
+
+        if( (restorePath && !cache.RestoreCheckpoint( restorePath ))
+            || (snapshotPath && !cache.OpenSnapshots( snapshotPath, interval )) )
+        {
+            delete trace;
+            return 1;
+        }
+        if( warmup ) cache.BeginWarmup( warmup );
+
+        start = Now();
+
+        while( (n = trace->NextBatch( &rec )) != 0 )
+        {
+            cache.LookupAndFillBatch( rec, n );
+            nrec += n;
+        }
+
+        if( trace->Failed() )
+        {
+            delete trace;
+            return 1;
+        }
+
+        elapsed = Now() - start;
+        ReportRate( nrec, elapsed );
+        cache.PrintStats( cout );
+
+        if( !cache.CloseSnapshots() || !WriteJSON( jsonPath, &cache )
+            || (savePath && !cache.SaveCheckpoint( savePath )) )
+        {
+            delete trace;
+            return 1;
+        }
+    }
+    else
+    {
+        CRC_PARALLEL_CACHE cache( cacheSize, assoc, threads, workers, linesize, policy );
+
+        for(UINT32 w=0; w<workers; w++) ConfigurePolicy( cache.Shard(w), options, threads );
+        cache.SetSeed( options.seed );
+
+        start = Now();
+
+        while( (n = trace->NextBatch( &rec )) != 0 )
+        {
+            for(UINT32 i=0; i<n; i++)
+            {
+                cache.Access( rec[i] );
+            }
+            nrec += n;
+        }
+        cache.Finish();
+
+        if( trace->Failed() )
+        {
+            delete trace;
+            return 1;
+        }
+
+        elapsed = Now() - start;
+        ReportRate( nrec, elapsed );
+        cache.PrintStats( cout );
+    }
+
+    delete trace;
+
+    return 0;
+}
@@ -0,0 +1,170 @@
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// LRU miss curves in one pass over a trace (stack_distance.h). For a given   //
+// number of sets the miss count of every associativity up to the maximum is  //
+// printed; without a set count the curve is for fully associative caches.    //
+//                                                                            //
+// With -c the same pass also runs CRC_CACHE with CRC_REPL_LRU at a few       //
+// sampled sizes and compares its miss counts with the stack distances.       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <unistd.h>
+
+#include "crc_cache.h"
+#include "stack_distance.h"
+#include "trace.h"
+
+static void Usage( const char *prog )
+{
+    cerr<<"usage: "<<prog<<" [options] <trace>"<<endl;
+    cerr<<"  -n <sets>      number of sets, a power of two (default 4096)"<<endl;
+    cerr<<"  -a <assoc>     largest associativity of the curve, at most "<<CRC_STACK_MAXWAYS<<" (default 32)"<<endl;
+    cerr<<"  -f <lines>     fully associative curve up to this many lines instead"<<endl;
+    cerr<<"  -l <linesize>  line size in bytes (default 64)"<<endl;
+    cerr<<"  -t <threads>   number of threads (default taken from the trace)"<<endl;
+    cerr<<"  -c             cross-check sampled sizes against CRC_CACHE with LRU"<<endl;
+    exit(1);
+}
+
+int main( int argc, char **argv )
+{
+    UINT32 numsets  = 4096;
+    UINT32 maxAssoc = 32;
+    UINT32 maxLines = 0;
+    UINT32 linesize = 64;
+    UINT32 threads  = 0;
+    bool   check    = false;
+    int    opt;
+
+    while( (opt = getopt( argc, argv, "n:a:f:l:t:ch" )) != -1 )
+    {
+        switch( opt )
+        {
+            case 'n': numsets  = atoi( optarg ); break;
+            case 'a': maxAssoc = atoi( optarg ); break;
+            case 'f': maxLines = atoi( optarg ); break;
+            case 'l': linesize = atoi( optarg ); break;
+            case 't': threads  = atoi( optarg ); break;
+            case 'c': check    = true; break;
+            default:  Usage( argv[0] );
+        }
+    }
+
+    if( optind != argc - 1 ) Usage( argv[0] );
+
+    if( maxLines ) numsets = 0;
+
+    if( numsets && ((numsets & (numsets - 1)) != 0 || maxAssoc == 0 || maxAssoc > CRC_STACK_MAXWAYS) )
+    {
+        cerr<<"-n must be a power of two and -a between 1 and "<<CRC_STACK_MAXWAYS<<endl;
+        return 1;
+    }
+
+    TRACE_SOURCE *trace = OpenTraceSource( argv[optind] );
+    if( trace == NULL ) return 1;
+
+    if( threads == 0 ) threads = trace->NumThreads();
+    if( threads == 0 ) threads = 1;
+
+    if( threads > CRC_MAX_THREADS )
+    {
+        cerr<<"at most "<<CRC_MAX_THREADS<<" threads are supported, not "<<threads<<endl;
+        delete trace;
+        return 1;
+    }
+    if( threads < trace->NumThreads() )
+    {
+        cerr<<"-t "<<threads<<" is fewer than the "<<trace->NumThreads()<<" threads of the trace"<<endl;
+        delete trace;
+        return 1;
+    }
+
+    UINT32             maxDepth = numsets ? maxAssoc : maxLines;
+    CRC_STACK_DISTANCE stack( numsets, maxDepth, linesize );
+
+    // Sampled cross-check points: smallest, middle and largest associativity.
+    // A fully associative cache is modeled as a single set, so its samples
+    // are limited to what the tag store can hold.
+    vector<UINT32>      samples;
+    vector<CRC_CACHE *> caches;
+
+    if( check )
+    {
+        UINT32 largest = numsets ? maxDepth : (maxDepth < CRC_TAG_STORE_MAXWAYS ? maxDepth : CRC_TAG_STORE_MAXWAYS);
+        UINT32 points[3] = { 1, (largest + 1) / 2, largest };
+
+        for(UINT32 i=0; i<3; i++)
+        {
+            if( !samples.empty() && samples.back() == points[i] ) continue;
+
+            UINT32 sets = numsets ? numsets : 1;
+
+            samples.push_back( points[i] );
+            caches.push_back( new CRC_CACHE( sets * points[i] * linesize, points[i], threads, linesize, CRC_REPL_LRU ) );
+        }
+    }
+
+    const TRACE_RECORD *rec;
+    UINT32              n;
+
+    while( (n = trace->NextBatch( &rec )) != 0 )
+    {
+        for(UINT32 i=0; i<n; i++)
+        {
+            stack.Access( rec[i].tid, rec[i].PC, rec[i].paddr, rec[i].accessType );
+        }
+
+        for(UINT32 c=0; c<caches.size(); c++)
+        {
+            caches[c]->LookupAndFillBatch( rec, n );
+        }
+    }
+
+    if( trace->Failed() )
+    {
+        for(UINT32 c=0; c<caches.size(); c++) delete caches[c];
+        delete trace;
+        return 1;
+    }
+
+    stack.PrintStats( cout );
+
+    int status = 0;
+
+    if( check )
+    {
+        cout<<"Cross-check against CRC_CACHE (LRU): "<<endl;
+
+        for(UINT32 c=0; c<caches.size(); c++)
+        {
+            COUNTER stackMisses = 0, cacheMisses = 0;
+
+            for(UINT32 a=0; a<ACCESS_MAX; a++)
+            {
+                stackMisses += stack.Misses( samples[c], a );
+                for(UINT32 t=0; t<threads; t++) cacheMisses += caches[c]->MissStats( a, t );
+            }
+
+            cout<<"\t"<<(numsets ? "Assoc " : "Lines ")<<samples[c]<<": stack "<<stackMisses
+                <<" cache "<<cacheMisses<<(stackMisses == cacheMisses ? " ok" : " MISMATCH")<<endl;
+
+            if( stackMisses != cacheMisses && stack.WritebackSplits() == 0 ) status = 1;
+
+            delete caches[c];
+        }
+
+        if( stack.WritebackSplits() )
+        {
+            cout<<"\t("<<stack.WritebackSplits()<<" writebacks hit only in the larger caches,"
+                <<" so small differences are expected)"<<endl;
+        }
+        cout<<endl;
+    }
+
+    delete trace;
+
+    return status;
+}
@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Trace conversion utility: compresses raw traces, expands compressed ones,  //
+// builds next-use indexes for OPT and prints trace summaries.                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdlib>
+#include <cstring>
+#include <sys/stat.h>
+
+#include "trace.h"
+#include "trace_compress.h"
+#include "next_use.h"
+
+static void Usage( const char *prog )
+{
+    cerr<<"usage: "<<prog<<" compress <in-trace> <out.trz>"<<endl;
+    cerr<<"       "<<prog<<" decompress <in-trace> <out.trc>"<<endl;
+    cerr<<"       "<<prog<<" nextuse <raw-trace> <out.opt> [linesize]"<<endl;
+    cerr<<"       "<<prog<<" info <trace>"<<endl;
+    exit(1);
+}
+
+static COUNTER FileSize( const char *path )
+{
+    struct stat st;
+    return (stat( path, &st ) == 0) ? st.st_size : 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Copies every record of in to the writer out                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+template <class WRITER>
+static bool Convert( const char *in, const char *out )
+{
+    TRACE_SOURCE *src = OpenTraceSource( in );
+    if( src == NULL ) return false;
+
+    WRITER writer;
+    if( !writer.Open( out ) )
+    {
+        delete src;
+        return false;
+    }
+
+    const TRACE_RECORD *rec;
+    UINT32              n;
+
+    while( (n = src->NextBatch( &rec )) != 0 )
+    {
+        for(UINT32 i=0; i<n; i++)
+        {
+            writer.Write( rec[i].tid, rec[i].PC, rec[i].paddr, rec[i].accessType );
+        }
+    }
+
+    bool failed = src->Failed();
+    delete src;
+
+    if( !writer.Close() )
+    {
+        cerr<<"trace: error writing "<<out<<endl;
+        return false;
+    }
+    if( failed ) return false;
+
+    COUNTER inBytes  = FileSize( in );
+    COUNTER outBytes = FileSize( out );
+
+    cout<<in<<": "<<inBytes<<" bytes -> "<<out<<": "<<outBytes<<" bytes";
+    if( outBytes ) cout<<" (ratio "<<(double) inBytes / (double) outBytes<<")";
+    cout<<endl;
+
+    return true;
+}
+
+static bool Info( const char *path )
+{
+    TRACE_SOURCE *src = OpenTraceSource( path );
+    if( src == NULL ) return false;
+
+    COUNTER             perType[ ACCESS_MAX ] = { 0 };
+    const TRACE_RECORD *rec;
+    UINT32              n;
+
+    while( (n = src->NextBatch( &rec )) != 0 )
+    {
+        for(UINT32 i=0; i<n; i++) perType[ rec[i].accessType % ACCESS_MAX ]++;
+    }
+
+    if( src->Failed() )
+    {
+        delete src;
+        return false;
+    }
+
+    cout<<path<<":"<<endl;
+    cout<<"\tRecords:   "<<src->NumRecords()<<endl;
+    cout<<"\tThreads:   "<<src->NumThreads()<<endl;
+    cout<<"\tFile Size: "<<FileSize( path )<<" bytes"<<endl;
+    for(UINT32 a=0; a<ACCESS_MAX; a++)
+    {
+        if( perType[a] ) cout<<"\tType "<<a<<":    "<<perType[a]<<endl;
+    }
+
+    delete src;
+
+    return true;
+}
+
+int main( int argc, char **argv )
+{
+    if( argc == 4 && strcmp( argv[1], "compress" ) == 0 )
+    {
+        return Convert<CTRACE_WRITER>( argv[2], argv[3] ) ? 0 : 1;
+    }
+    if( argc == 4 && strcmp( argv[1], "decompress" ) == 0 )
+    {
+        return Convert<TRACE_WRITER>( argv[2], argv[3] ) ? 0 : 1;
+    }
+    if( (argc == 4 || argc == 5) && strcmp( argv[1], "nextuse" ) == 0 )
+    {
+        return BuildNextUseIndex( argv[2], argv[3], argc == 5 ? atoi( argv[4] ) : 64 ) ? 0 : 1;
+    }
+    if( argc == 3 && strcmp( argv[1], "info" ) == 0 )
+    {
+        return Info( argv[2] ) ? 0 : 1;
+    }
+
+    Usage( argv[0] );
+    return 1;
+}
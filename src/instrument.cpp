@@ -0,0 +1,213 @@
+#include "instrument.h"
+
+#include <algorithm>
+#include <iomanip>
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Space-saving update. A key that is not monitored takes over the entry      //
+// with the fewest misses and inherits its count as the error, so counts      //
+// never underestimate. The minimum is found by a scan, which is fine for a   //
+// few dozen entries.                                                         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_TOPK::Miss( Addr_t key )
+{
+    unordered_map<Addr_t, UINT32>::iterator it = slot.find( key );
+
+    if( it != slot.end() )
+    {
+        entries[ it->second ].count++;
+        return;
+    }
+
+    if( entries.size() < capacity )
+    {
+        TOPK_ENTRY entry = { key, 1, 0, 0 };
+
+        slot[ key ] = entries.size();
+        entries.push_back( entry );
+        return;
+    }
+
+    UINT32 victim = 0;
+    for(UINT32 i=1; i<entries.size(); i++)
+    {
+        if( entries[i].count < entries[ victim ].count ) victim = i;
+    }
+
+    TOPK_ENTRY &entry = entries[ victim ];
+
+    slot.erase( entry.key );
+    slot[ key ] = victim;
+
+    entry.key   = key;
+    entry.error = entry.count;
+    entry.count = entry.count + 1;
+    entry.hits  = 0;
+}
+
+static bool ByMisses( const TOPK_ENTRY &a, const TOPK_ENTRY &b )
+{
+    return a.count > b.count || (a.count == b.count && a.key < b.key);
+}
+
+vector<TOPK_ENTRY> CRC_TOPK::Sorted() const
+{
+    vector<TOPK_ENTRY> sorted( entries );
+
+    sort( sorted.begin(), sorted.end(), ByMisses );
+    return sorted;
+}
+
+CRC_INSTRUMENT::CRC_INSTRUMENT( UINT32 _sets, UINT32 _assoc ) : pcs( CRC_TOPK_PCS )
+{
+    numsets  = _sets;
+    assoc    = _assoc;
+    now      = 0;
+    bypasses = 0;
+    lock     = NULL;
+
+    setLookups = new COUNTER[ numsets ];
+    setMisses  = new COUNTER[ numsets ];
+    for(UINT32 s=0; s<numsets; s++) setLookups[s] = setMisses[s] = 0;
+
+    COUNTER lines = (COUNTER) numsets * assoc;
+
+    fillTime   = new COUNTER[ lines ];
+    lastAccess = new COUNTER[ lines ];
+    reused     = new unsigned char[ lines ];
+    for(COUNTER l=0; l<lines; l++)
+    {
+        fillTime[l]   = 0;
+        lastAccess[l] = 0;
+        reused[l]     = 0;
+    }
+
+    for(UINT32 b=0; b<CRC_HIST_BUCKETS; b++)
+    {
+        reuseDistance[b]  = 0;
+        evictionAge[0][b] = 0;
+        evictionAge[1][b] = 0;
+    }
+}
+
+CRC_INSTRUMENT::~CRC_INSTRUMENT()
+{
+    delete [] setLookups;
+    delete [] setMisses;
+    delete [] fillTime;
+    delete [] lastAccess;
+    delete [] reused;
+    delete lock;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Text summary: the PCs and sets with the most misses and the median of      //
+// the histograms                                                             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+static UINT32 MedianBucket( const COUNTER *hist )
+{
+    COUNTER total = 0, seen = 0;
+
+    for(UINT32 b=0; b<CRC_HIST_BUCKETS; b++) total += hist[b];
+    for(UINT32 b=0; b<CRC_HIST_BUCKETS; b++)
+    {
+        seen += hist[b];
+        if( 2 * seen >= total && total ) return b;
+    }
+
+    return 0;
+}
+
+ostream & CRC_INSTRUMENT::PrintStats( ostream &out )
+{
+    ios::fmtflags flags = out.flags();
+
+    vector<TOPK_ENTRY> top = pcs.Sorted();
+
+    out<<"Instrumentation: "<<endl;
+    out<<"\tTop Missing PCs (misses overestimated by at most the error):"<<endl;
+    for(UINT32 i=0; i<top.size() && i<CRC_SUMMARY_ROWS; i++)
+    {
+        out<<"\t\tPC: 0x"<<hex<<top[i].key<<dec<<" Misses: "<<top[i].count<<" (error "<<top[i].error
+           <<") Hits: "<<top[i].hits<<endl;
+    }
+
+    vector<UINT32> sets( numsets );
+    for(UINT32 s=0; s<numsets; s++) sets[s] = s;
+
+    UINT32 rows = (numsets < CRC_SUMMARY_ROWS) ? numsets : CRC_SUMMARY_ROWS;
+    partial_sort( sets.begin(), sets.begin() + rows, sets.end(),
+                  [this]( UINT32 a, UINT32 b ) { return setMisses[a] > setMisses[b] || (setMisses[a] == setMisses[b] && a < b); } );
+
+    out<<"\tTop Missing Sets:"<<endl;
+    for(UINT32 i=0; i<rows; i++)
+    {
+        out<<"\t\tSet: "<<sets[i]<<" Lookups: "<<setLookups[ sets[i] ]<<" Misses: "<<setMisses[ sets[i] ]<<endl;
+    }
+
+    out<<"\tMedian Reuse Distance:       2^"<<MedianBucket( reuseDistance )<<" accesses"<<endl;
+    out<<"\tMedian Eviction Age, Reused: 2^"<<MedianBucket( evictionAge[1] )<<" accesses"<<endl;
+    out<<"\tMedian Eviction Age, Dead:   2^"<<MedianBucket( evictionAge[0] )<<" accesses"<<endl;
+    if( bypasses ) out<<"\tBypasses: "<<bypasses<<endl;
+    out<<endl;
+
+    out.flags( flags );
+
+    return out;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// JSON object with every counter; histograms are arrays indexed by log2      //
+// bucket, trailing empty buckets dropped                                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+ostream & CRC_INSTRUMENT::PrintHistogram( ostream &out, const COUNTER *hist )
+{
+    UINT32 used = CRC_HIST_BUCKETS;
+    while( used > 0 && hist[ used - 1 ] == 0 ) used--;
+
+    out<<"[";
+    for(UINT32 b=0; b<used; b++) out<<(b ? ", " : "")<<hist[b];
+    out<<"]";
+
+    return out;
+}
+
+ostream & CRC_INSTRUMENT::PrintJSON( ostream &out )
+{
+    vector<TOPK_ENTRY> top = pcs.Sorted();
+
+    out<<"{"<<endl;
+    out<<"    \"accesses\": "<<now<<","<<endl;
+    out<<"    \"bypasses\": "<<bypasses<<","<<endl;
+
+    out<<"    \"set_lookups\": [";
+    for(UINT32 s=0; s<numsets; s++) out<<(s ? ", " : "")<<setLookups[s];
+    out<<"],"<<endl;
+
+    out<<"    \"set_misses\": [";
+    for(UINT32 s=0; s<numsets; s++) out<<(s ? ", " : "")<<setMisses[s];
+    out<<"],"<<endl;
+
+    out<<"    \"top_pcs\": ["<<endl;
+    for(UINT32 i=0; i<top.size(); i++)
+    {
+        out<<"        { \"pc\": "<<top[i].key<<", \"misses\": "<<top[i].count<<", \"error\": "<<top[i].error
+           <<", \"hits\": "<<top[i].hits<<" }"<<(i + 1 < top.size() ? "," : "")<<endl;
+    }
+    out<<"    ],"<<endl;
+
+    out<<"    \"reuse_distance_log2\": ";
+    PrintHistogram( out, reuseDistance )<<","<<endl;
+    out<<"    \"eviction_age_log2\": { \"reused\": ";
+    PrintHistogram( out, evictionAge[1] )<<", \"dead\": ";
+    PrintHistogram( out, evictionAge[0] )<<" }"<<endl;
+    out<<"}";
+
+    return out;
+}
@@ -0,0 +1,172 @@
+#ifndef CRC_INSTRUMENT_H
+#define CRC_INSTRUMENT_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Optional instrumentation of the cache access path, compiled in with        //
+// -DCRC_INSTRUMENTATION (make INSTRUMENT=1). Without it CRC_INSTRUMENTED is  //
+// 0, CRC_CACHE allocates nothing and its hooks are discarded at compile      //
+// time.                                                                      //
+//                                                                            //
+// Per cache it records                                                       //
+//                                                                            //
+//   sets           lookups and misses of every set                           //
+//   top PCs        the CRC_TOPK_PCS PCs with the most misses, found with a   //
+//                  space-saving sketch (Metwally et al., ICDT'05): every     //
+//                  reported count overestimates the true one by at most      //
+//                  its error, and every PC with more misses than the         //
+//                  smallest reported count is in the list. The hits of a     //
+//                  PC are counted from when it entered the list.             //
+//   reuse distance for every hit, the cache accesses since the previous      //
+//                  access to the line                                        //
+//   eviction age   for every eviction, the cache accesses since the fill,    //
+//                  separately for lines that were and were not reused        //
+//                                                                            //
+// Distances fall into log2 buckets: bucket b holds [2^b, 2^(b+1)).           //
+// PrintJSON writes everything for scripts; PrintStats adds a short summary   //
+// to the text statistics.                                                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <vector>
+#include <unordered_map>
+#include "utils.h"
+#include "spin_lock.h"
+
+#ifdef CRC_INSTRUMENTATION
+#define CRC_INSTRUMENTED    1
+#else
+#define CRC_INSTRUMENTED    0
+#endif
+
+#define CRC_TOPK_PCS        32      // PCs tracked by the sketch
+#define CRC_HIST_BUCKETS    64      // log2 buckets of a 64-bit distance
+#define CRC_SUMMARY_ROWS    10      // rows of the text summary
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Space-saving top-K sketch of miss counts per key                           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+typedef struct
+{
+    Addr_t      key;
+    COUNTER     count;      // misses, overestimated by at most error
+    COUNTER     error;
+    COUNTER     hits;       // hits while monitored
+} TOPK_ENTRY;
+
+class CRC_TOPK
+{
+  private:
+
+    UINT32                          capacity;
+    vector<TOPK_ENTRY>              entries;
+    unordered_map<Addr_t, UINT32>   slot;       // key -> index in entries
+
+  public:
+
+    CRC_TOPK( UINT32 _capacity ) : capacity( _capacity ) { assert( capacity > 0 ); }
+
+    // A miss of key: count it, or replace the entry with the fewest misses
+    void    Miss( Addr_t key );
+
+    void    Hit( Addr_t key )
+    {
+        unordered_map<Addr_t, UINT32>::iterator it = slot.find( key );
+        if( it != slot.end() ) entries[ it->second ].hits++;
+    }
+
+    // Entries by decreasing miss count
+    vector<TOPK_ENTRY> Sorted() const;
+};
+
+class CRC_INSTRUMENT
+{
+  private:
+
+    UINT32          numsets;
+    UINT32          assoc;
+    COUNTER         now;            // instrumented accesses so far
+
+    COUNTER        *setLookups;
+    COUNTER        *setMisses;
+
+    // Per line: time of the fill and of the last access, and whether it
+    // was hit since the fill
+    COUNTER        *fillTime;
+    COUNTER        *lastAccess;
+    unsigned char  *reused;
+
+    CRC_TOPK        pcs;
+    COUNTER         reuseDistance[ CRC_HIST_BUCKETS ];
+    COUNTER         evictionAge[2][ CRC_HIST_BUCKETS ];     // [reused]
+    COUNTER         bypasses;
+
+    // Shared mode: events of different sets may come from several threads
+    CRC_SPIN_LOCK  *lock;
+
+  public:
+
+    CRC_INSTRUMENT( UINT32 _sets, UINT32 _assoc );
+    ~CRC_INSTRUMENT();
+
+    // Serialize the events; call before the first access
+    void    EnableSharedAccess() { if( lock == NULL ) lock = new CRC_SPIN_LOCK; }
+
+    void    Hit( UINT32 setIndex, INT32 way, Addr_t PC )
+    {
+        CRC_SPIN_GUARD guard( lock );
+        COUNTER        line = (COUNTER) setIndex * assoc + way;
+
+        now++;
+        setLookups[ setIndex ]++;
+        pcs.Hit( PC );
+
+        reuseDistance[ Bucket( now - lastAccess[ line ] ) ]++;
+        lastAccess[ line ] = now;
+        reused[ line ]     = 1;
+    }
+
+    // A miss that is filled into way (-1 for a bypass); evicted tells if
+    // the way held a valid line
+    void    Miss( UINT32 setIndex, INT32 way, bool evicted, Addr_t PC )
+    {
+        CRC_SPIN_GUARD guard( lock );
+
+        now++;
+        setLookups[ setIndex ]++;
+        setMisses[ setIndex ]++;
+        pcs.Miss( PC );
+
+        if( way < 0 )
+        {
+            bypasses++;
+            return;
+        }
+
+        COUNTER line = (COUNTER) setIndex * assoc + way;
+
+        if( evicted ) evictionAge[ reused[ line ] ][ Bucket( now - fillTime[ line ] ) ]++;
+
+        fillTime[ line ]   = now;
+        lastAccess[ line ] = now;
+        reused[ line ]     = 0;
+    }
+
+    ostream &   PrintStats( ostream &out );
+    ostream &   PrintJSON( ostream &out );
+
+  private:
+
+    static UINT32 Bucket( COUNTER distance ) { return 63 - __builtin_clzll( distance | 1 ); }
+
+    static ostream & PrintHistogram( ostream &out, const COUNTER *hist );
+
+    CRC_INSTRUMENT( const CRC_INSTRUMENT & );
+    CRC_INSTRUMENT & operator=( const CRC_INSTRUMENT & );
+};
+
+#endif
@@ -0,0 +1,281 @@
+#include "next_use.h"
+#include "trace.h"
+
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Line address -> last seen position, open addressing with linear probing.   //
+// The scan does one lookup per access, so this is the cost of the build.     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+class LINE_TABLE
+{
+  private:
+
+    Addr_t     *lines;
+    COUNTER    *values;
+    COUNTER     mask;
+    COUNTER     used;
+
+  public:
+
+    LINE_TABLE() { Alloc( 1 << 16 ); }
+    ~LINE_TABLE() { delete [] lines; delete [] values; }
+
+    // Entry of line, created as CRC_NEVER_USED if it is not in the table
+    COUNTER & Lookup( Addr_t line )
+    {
+        Addr_t  key  = line + 1;     // 0 marks an empty slot
+        COUNTER slot = Hash( key ) & mask;
+
+        while( lines[ slot ] != key )
+        {
+            if( lines[ slot ] == 0 )
+            {
+                if( 2 * (used + 1) > mask + 1 )
+                {
+                    Grow();
+                    return Lookup( line );
+                }
+
+                lines[ slot ]  = key;
+                values[ slot ] = CRC_NEVER_USED;
+                used++;
+                break;
+            }
+            slot = (slot + 1) & mask;
+        }
+
+        return values[ slot ];
+    }
+
+  private:
+
+    static COUNTER Hash( Addr_t key )
+    {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    void Alloc( COUNTER slots )
+    {
+        lines  = new Addr_t[ slots ];
+        values = new COUNTER[ slots ];
+        mask   = slots - 1;
+        used   = 0;
+        memset( lines, 0, slots * sizeof(Addr_t) );
+    }
+
+    void Grow()
+    {
+        Addr_t  *oldLines  = lines;
+        COUNTER *oldValues = values;
+        COUNTER  oldSlots  = mask + 1;
+
+        Alloc( 2 * oldSlots );
+
+        for(COUNTER i=0; i<oldSlots; i++)
+        {
+            if( oldLines[i] == 0 ) continue;
+
+            COUNTER slot = Hash( oldLines[i] ) & mask;
+            while( lines[ slot ] != 0 ) slot = (slot + 1) & mask;
+
+            lines[ slot ]  = oldLines[i];
+            values[ slot ] = oldValues[i];
+            used++;
+        }
+
+        delete [] oldLines;
+        delete [] oldValues;
+    }
+
+    LINE_TABLE( const LINE_TABLE & );
+    LINE_TABLE & operator=( const LINE_TABLE & );
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function builds the index back to front, one window at a time: the     //
+// next use of an access is the position at which its line was last seen      //
+// further down the trace. Each finished window is written to its place in    //
+// the file, and the header goes in last, so that an interrupted build does   //
+// not leave a file that passes for an index.                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool BuildNextUseIndex( const char *tracePath, const char *indexPath, UINT32 linesize )
+{
+    TRACE_READER trace;
+
+    if( !trace.Open( tracePath ) )
+    {
+        cerr<<"next-use: the index can only be built from a raw trace"<<endl;
+        return false;
+    }
+
+    int fd = open( indexPath, O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if( fd < 0 )
+    {
+        cerr<<"next-use: cannot create "<<indexPath<<endl;
+        return false;
+    }
+
+    NEXT_USE_HEADER header;
+    memset( &header, 0, sizeof(header) );
+    header.magic      = CRC_NEXT_USE_MAGIC;
+    header.numRecords = trace.NumRecords();
+    header.linesize   = linesize;
+
+    const TRACE_RECORD *records   = trace.Records();
+    UINT32              lineShift = CRC_FloorLog2( linesize );
+    COUNTER            *window    = new COUNTER[ CRC_NEXT_USE_WINDOW ];
+    bool                ok        = true;
+
+    LINE_TABLE lastSeen;
+
+    for(COUNTER end=header.numRecords; ok && end>0; )
+    {
+        COUNTER start = (end > CRC_NEXT_USE_WINDOW) ? end - CRC_NEXT_USE_WINDOW : 0;
+
+        // The mapping is read backwards; ask for the window up front
+        uintptr_t page  = (uintptr_t) sysconf( _SC_PAGESIZE );
+        uintptr_t first = (uintptr_t) (records + start) & ~(page - 1);
+        madvise( (void *) first, (uintptr_t) (records + end) - first, MADV_WILLNEED );
+
+        for(COUNTER i=end; i-- > start; )
+        {
+            Addr_t line = records[i].paddr >> lineShift;
+
+            COUNTER &last = lastSeen.Lookup( line );
+
+            window[ i - start ] = last;
+            last                = i;
+        }
+
+        size_t  bytes  = (end - start) * sizeof(COUNTER);
+        off_t   offset = sizeof(header) + start * sizeof(COUNTER);
+
+        ok  = pwrite( fd, window, bytes, offset ) == (ssize_t) bytes;
+        end = start;
+    }
+
+    delete [] window;
+
+    if( ok ) ok = pwrite( fd, &header, sizeof(header), 0 ) == sizeof(header);
+
+    if( close( fd ) != 0 ) ok = false;
+    if( !ok ) cerr<<"next-use: write to "<<indexPath<<" failed"<<endl;
+
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The reader starts off with no index open                                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+NEXT_USE_READER::NEXT_USE_READER()
+{
+    fd         = -1;
+    window     = new COUNTER[ CRC_NEXT_USE_WINDOW ];
+    windowSize = 0;
+    cursor     = 0;
+    consumed   = 0;
+    failed     = false;
+    memset( &header, 0, sizeof(header) );
+}
+
+NEXT_USE_READER::~NEXT_USE_READER()
+{
+    Close();
+    delete [] window;
+}
+
+bool NEXT_USE_READER::Open( const char *path )
+{
+    Close();
+
+    fd = open( path, O_RDONLY );
+    if( fd < 0 )
+    {
+        cerr<<"next-use: cannot open "<<path<<endl;
+        return false;
+    }
+
+    if( read( fd, &header, sizeof(header) ) != sizeof(header) || header.magic != CRC_NEXT_USE_MAGIC )
+    {
+        cerr<<"next-use: "<<path<<" is not a next-use index"<<endl;
+        Close();
+        return false;
+    }
+
+    struct stat st;
+
+    if( fstat( fd, &st ) != 0
+        || (COUNTER) st.st_size != sizeof(header) + header.numRecords * sizeof(COUNTER) )
+    {
+        cerr<<"next-use: "<<path<<" is truncated or corrupt; delete it to rebuild it"<<endl;
+        Close();
+        return false;
+    }
+
+    posix_fadvise( fd, 0, 0, POSIX_FADV_SEQUENTIAL );
+
+    return true;
+}
+
+void NEXT_USE_READER::Close()
+{
+    if( fd >= 0 ) close( fd );
+
+    fd         = -1;
+    windowSize = 0;
+    cursor     = 0;
+    consumed   = 0;
+    failed     = false;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function reads the next window of the index. Reading past the end of   //
+// the index is an error in the caller: the index belongs to another trace.   //
+// A failed read marks the reader failed and the rest of the window as never  //
+// used again.                                                                //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void NEXT_USE_READER::Refill()
+{
+    COUNTER left = header.numRecords - consumed;
+    UINT32  n    = (left < CRC_NEXT_USE_WINDOW) ? (UINT32) left : CRC_NEXT_USE_WINDOW;
+
+    assert( fd >= 0 && n > 0 );
+
+    size_t  bytes = n * sizeof(COUNTER);
+    size_t  done  = 0;
+
+    while( done < bytes )
+    {
+        ssize_t got = read( fd, (char *) window + done, bytes - done );
+        if( got <= 0 ) break;
+        done += got;
+    }
+
+    if( done < bytes )
+    {
+        if( !failed ) cerr<<"next-use: read of the index failed"<<endl;
+        failed = true;
+        for(UINT32 i=done / sizeof(COUNTER); i<n; i++) window[i] = CRC_NEVER_USED;
+    }
+
+    windowSize  = n;
+    cursor      = 0;
+    consumed   += n;
+}
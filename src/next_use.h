@@ -0,0 +1,81 @@
+#ifndef CRC_NEXT_USE_H
+#define CRC_NEXT_USE_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Next-use index for the Belady/OPT replacement policy (CRC_REPL_OPT). For   //
+// every access of a trace the index holds the position in the trace of the   //
+// next access to the same line, or CRC_NEVER_USED if there is none.          //
+//                                                                            //
+// The index is built by one backward scan over a memory-mapped raw trace     //
+// (compressed traces must be expanded with crc_trace first) and written to   //
+// a file, one COUNTER per access after a small header. The only state kept   //
+// in memory while building is the last position of every distinct line.      //
+// During simulation NEXT_USE_READER streams the file in fixed-size windows   //
+// in step with the trace, so the index never has to fit in memory.           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "utils.h"
+
+#define CRC_NEXT_USE_MAGIC    0x0031455355584e43ULL   // "CNXUSE1\0"
+#define CRC_NEVER_USED        (~0ULL)
+#define CRC_NEXT_USE_WINDOW   (1 << 20)               // entries per window
+
+// File header, always at offset 0
+typedef struct
+{
+    COUNTER     magic;       // CRC_NEXT_USE_MAGIC
+    COUNTER     numRecords;  // number of entries following the header
+    UINT32      linesize;    // line size the index was built for
+    UINT32      reserved;
+} NEXT_USE_HEADER;
+
+// Builds the index of the raw trace at tracePath. Returns false (with an
+// explanation on cerr) on failure.
+bool BuildNextUseIndex( const char *tracePath, const char *indexPath, UINT32 linesize );
+
+class NEXT_USE_READER
+{
+  private:
+
+    int              fd;
+    NEXT_USE_HEADER  header;
+    COUNTER         *window;
+    UINT32           windowSize;   // valid entries in window
+    UINT32           cursor;       // next entry of window handed out
+    COUNTER          consumed;     // entries handed out so far
+    bool             failed;       // a read of the file failed
+
+  public:
+
+    NEXT_USE_READER();
+    ~NEXT_USE_READER();
+
+    bool    Open( const char *path );
+    void    Close();
+
+    COUNTER NumRecords() const { return header.numRecords; }
+    UINT32  LineSize() const { return header.linesize; }
+
+    // True if a read failed; the next uses handed out since are wrong
+    bool    Failed() const { return failed; }
+
+    // Next use of the next access of the trace
+    COUNTER Next()
+    {
+        if( cursor == windowSize ) Refill();
+
+        return window[ cursor++ ];
+    }
+
+  private:
+
+    void    Refill();
+
+    NEXT_USE_READER( const NEXT_USE_READER & );
+    NEXT_USE_READER & operator=( const NEXT_USE_READER & );
+};
+
+#endif
@@ -0,0 +1,218 @@
+#include "parallel_sim.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The constructor creates one shard cache, queue and worker per worker       //
+// thread. The number of workers must be a power of two no larger than the    //
+// number of sets.                                                            //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+CRC_PARALLEL_CACHE::CRC_PARALLEL_CACHE( UINT32 _cacheSize, UINT32 _assoc, UINT32 _tpc, UINT32 _workers,
+                                        UINT32 _linesize, UINT32 _pol )
+{
+    numsets     = _cacheSize / (_linesize * _assoc);
+    assoc       = _assoc;
+    threads     = _tpc;
+    linesize    = _linesize;
+    replPolicy  = _pol;
+    numWorkers  = _workers;
+    workerShift = CRC_FloorLog2( numWorkers );
+    lineShift   = CRC_FloorLog2( linesize );
+
+    assert( numWorkers && (numWorkers & (numWorkers - 1)) == 0 );
+    assert( numWorkers <= numsets );
+
+    done = false;
+
+    for(UINT32 w=0; w<numWorkers; w++)
+    {
+        shards.push_back( new CRC_CACHE( _cacheSize / numWorkers, assoc, threads, linesize, replPolicy ) );
+        queues.push_back( new SPSC_QUEUE<TRACE_RECORD>( PARALLEL_QUEUE_RECORDS ) );
+        stage.push_back( new TRACE_RECORD[ PARALLEL_STAGE_RECORDS ] );
+        staged.push_back( 0 );
+    }
+
+    for(UINT32 w=0; w<numWorkers; w++) shards[w]->ReplacementState()->SetShard( w, numWorkers );
+
+    SetSeed( CRC_RANDOM_DEFAULT_SEED );
+
+    for(UINT32 w=0; w<numWorkers; w++)
+    {
+        workers.push_back( thread( &CRC_PARALLEL_CACHE::WorkerLoop, this, w ) );
+    }
+}
+
+CRC_PARALLEL_CACHE::~CRC_PARALLEL_CACHE()
+{
+    Finish();
+
+    for(UINT32 w=0; w<numWorkers; w++)
+    {
+        delete shards[w];
+        delete queues[w];
+        delete [] stage[w];
+    }
+}
+
+void CRC_PARALLEL_CACHE::SetSeed( BITVECTOR seed )
+{
+    for(UINT32 w=0; w<numWorkers; w++) shards[w]->ReplacementState()->SetSeed( seed );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function hands the staged records of one worker to its queue           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_PARALLEL_CACHE::Flush( UINT32 worker )
+{
+    queues[ worker ]->Push( stage[ worker ], staged[ worker ] );
+    staged[ worker ] = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function flushes all staged records, tells the workers that no more    //
+// input is coming and waits for them to drain their queues                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_PARALLEL_CACHE::Finish()
+{
+    if( workers.empty() ) return;
+
+    for(UINT32 w=0; w<numWorkers; w++)
+    {
+        if( staged[w] ) Flush( w );
+    }
+
+    done.store( true, memory_order_release );
+
+    for(UINT32 w=0; w<numWorkers; w++)
+    {
+        workers[w].join();
+    }
+    workers.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Body of a worker thread: drain the queue into the shard until the          //
+// dispatcher is done and the queue is empty                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_PARALLEL_CACHE::WorkerLoop( UINT32 worker )
+{
+    SPSC_QUEUE<TRACE_RECORD> *queue = queues[ worker ];
+    CRC_CACHE                *cache = shards[ worker ];
+    TRACE_RECORD              batch[ PARALLEL_STAGE_RECORDS ];
+    bool                      local = false;
+
+    while( true )
+    {
+        // Sample the flag before polling so the final records are not missed
+        bool   last = done.load( memory_order_acquire );
+        UINT32 n    = queue->Pop( batch, PARALLEL_STAGE_RECORDS );
+
+        // The shard is configured once records arrive; make it local to
+        // this thread before simulating them
+        if( n && !local )
+        {
+            cache->MoveToLocalNode();
+            local = true;
+        }
+
+        cache->LookupAndFillBatch( batch, n );
+
+        if( n == 0 )
+        {
+            if( last ) break;
+            this_thread::yield();
+        }
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function prints the statistics of all shards merged, in the same       //
+// format as CRC_CACHE::PrintStats, followed by the per-shard replacement     //
+// policy statistics                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+ostream & CRC_PARALLEL_CACHE::PrintStats( ostream &out )
+{
+    COUNTER totLookups = 0, totMisses = 0, totHits = 0;
+
+    out<<"=========================================================="<<endl;
+    out<<"==== Cache Replacement Championship -- LLC Statistics ===="<<endl;
+    out<<"=========================================================="<<endl;
+    out<<endl;
+    out<<endl;
+    out<<"Cache Configuration: "<<endl;
+    out<<"\tCache Size:     "<<(numsets*assoc*linesize/1024)<<"K"<<endl;
+    out<<"\tLine Size:      "<<linesize<<"B"<<endl;
+    out<<"\tAssociativity:  "<<assoc<<endl;
+    out<<"\tTot # Sets:     "<<numsets<<endl;
+    out<<"\tTot # Threads:  "<<threads<<endl;
+    out<<"\tSim Workers:    "<<numWorkers<<endl;
+
+    out<<endl;
+    out<<"Cache Statistics: "<<endl;
+    out<<endl;
+
+    for(UINT32 a=0; a<ACCESS_MAX; a++)
+    {
+        totLookups = 0;
+        totMisses  = 0;
+        totHits    = 0;
+
+        for(UINT32 w=0; w<numWorkers; w++)
+        {
+            for(UINT32 t=0; t<threads; t++)
+            {
+                totLookups += shards[w]->LookupStats( a, t );
+                totMisses  += shards[w]->MissStats( a, t );
+                totHits    += shards[w]->HitStats( a, t );
+            }
+        }
+
+        if( totLookups )
+        {
+            out<<"\t"<<crc_access_names[a]<<" Accesses:   "<<totLookups<<endl;
+            out<<"\t"<<crc_access_names[a]<<" Misses:     "<<totMisses<<endl;
+            out<<"\t"<<crc_access_names[a]<<" Hits:       "<<totHits<<endl;
+            out<<"\t"<<crc_access_names[a]<<" Miss Rate:  "<<((double)totMisses/(double)totLookups)*100.0<<endl;
+
+            out<<endl;
+        }
+    }
+
+    out<<endl;
+    out<<"Per Thread Demand Reference Statistics: "<<endl;
+
+    for(UINT32 t=0; t<threads; t++)
+    {
+        totLookups = 0;
+        totMisses  = 0;
+
+        for(UINT32 w=0; w<numWorkers; w++)
+        {
+            totLookups += shards[w]->ThreadDemandLookupStats(t);
+            totMisses  += shards[w]->ThreadDemandMissStats(t);
+        }
+
+        if( totLookups )
+        {
+            out<<"\tThread: "<<t<<" Lookups: "<<totLookups<<" Misses: "<<totMisses
+                <<" Miss Rate: "<<((double)totMisses/(double)totLookups)*100.0<<endl;
+        }
+    }
+    out<<endl;
+
+    for(UINT32 w=0; w<numWorkers; w++)
+    {
+        out<<"Shard "<<w<<":"<<endl;
+        shards[w]->ReplacementState()->PrintStats( out );
+    }
+
+    return out;
+}
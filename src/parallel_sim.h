@@ -0,0 +1,98 @@
+#ifndef CRC_PARALLEL_SIM_H
+#define CRC_PARALLEL_SIM_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Set-partitioned parallel simulation of one LLC. The sets of the modeled    //
+// cache are split across numWorkers shards by the low bits of the set        //
+// index; every shard is an ordinary CRC_CACHE holding numsets/numWorkers     //
+// sets and is driven by its own worker thread. The dispatching thread        //
+// routes each access to its shard over a per-worker SPSC queue.              //
+//                                                                            //
+// Dropping the shard bits from the line address maps set s of the full       //
+// cache onto set s/numWorkers of its shard with an unchanged tag order, so   //
+// every set sees exactly the same access sequence as in a serial run.        //
+// Policies whose state is purely per-set (LRU, SRRIP, PLRU, and BIP and      //
+// BRRIP, whose bimodal insertion is drawn per set) therefore give            //
+// bit-identical results; policies with cache-wide state (set dueling, SHiP   //
+// counters, random victims) see only their shard's accesses. Every shard     //
+// draws its random victims from a stream of its own.                         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "crc_cache.h"
+#include "trace.h"
+#include "spsc_queue.h"
+
+#define PARALLEL_QUEUE_RECORDS   (1 << 16)   // per-worker queue capacity
+#define PARALLEL_STAGE_RECORDS   256         // records routed per queue push
+
+class CRC_PARALLEL_CACHE
+{
+  private:
+
+    // parameters
+    UINT32 numWorkers;
+    UINT32 workerShift;
+    UINT32 numsets;
+    UINT32 assoc;
+    UINT32 threads;
+    UINT32 linesize;
+    UINT32 replPolicy;
+    UINT32 lineShift;
+
+    vector<CRC_CACHE *>                 shards;
+    vector<SPSC_QUEUE<TRACE_RECORD> *>  queues;
+    vector<thread>                      workers;
+    atomic<bool>                        done;
+
+    // Dispatcher-side staging buffers, one per worker
+    vector<TRACE_RECORD *>              stage;
+    vector<UINT32>                      staged;
+
+  public:
+
+    CRC_PARALLEL_CACHE( UINT32 _cacheSize, UINT32 _assoc, UINT32 _tpc, UINT32 _workers,
+                        UINT32 _linesize=64, UINT32 _pol=CRC_REPL_LRU );
+    ~CRC_PARALLEL_CACHE();
+
+    // Dispatcher: route one access to its shard
+    void   Access( const TRACE_RECORD &rec )
+    {
+        Addr_t line   = rec.paddr >> lineShift;
+        UINT32 worker = (UINT32) line & (numWorkers - 1);
+
+        TRACE_RECORD &out = stage[ worker ][ staged[ worker ]++ ];
+
+        out       = rec;
+        out.paddr = ((line >> workerShift) << lineShift) | (rec.paddr & (linesize - 1));
+
+        if( staged[ worker ] == PARALLEL_STAGE_RECORDS ) Flush( worker );
+    }
+
+    // Drain all queues and wait for the workers; must be called before PrintStats
+    void   Finish();
+
+    ostream &   PrintStats( ostream &out );
+
+    // Seeds the random decisions of all shards; call before the first
+    // access
+    void   SetSeed( BITVECTOR seed );
+
+    UINT32 NumWorkers() const { return numWorkers; }
+    CRC_CACHE * Shard( UINT32 w ) { return shards[w]; }
+
+  private:
+
+    void   Flush( UINT32 worker );
+    void   WorkerLoop( UINT32 worker );
+
+    CRC_PARALLEL_CACHE( const CRC_PARALLEL_CACHE & );
+    CRC_PARALLEL_CACHE & operator=( const CRC_PARALLEL_CACHE & );
+};
+
+#endif
@@ -0,0 +1,41 @@
+#ifndef CRC_PREFETCH_H
+#define CRC_PREFETCH_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Software prefetch of simulator state. Batched lookups                      //
+// (CRC_CACHE::LookupAndFillBatch) prefetch the tag store and replacement     //
+// state of the set an access will touch CRC_PREFETCH_DISTANCE accesses       //
+// ahead, so that the host cache misses of a large modeled LLC overlap        //
+// instead of stalling one access at a time.                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+#include "utils.h"
+
+#ifndef CRC_CACHE_LINE
+#define CRC_CACHE_LINE  64
+#endif
+
+// Accesses between prefetch and use; may be tuned at build time
+#ifndef CRC_PREFETCH_DISTANCE
+#define CRC_PREFETCH_DISTANCE   8
+#endif
+
+// Prefetch the host lines covering bytes at addr; write if they will be
+// modified
+static inline void CRC_PrefetchRange( const void *addr, size_t bytes, bool write )
+{
+    const char *p   = (const char *) ((size_t) addr & ~(size_t) (CRC_CACHE_LINE - 1));
+    const char *end = (const char *) addr + bytes;
+
+    for( ; p < end; p += CRC_CACHE_LINE )
+    {
+        if( write ) __builtin_prefetch( p, 1, 3 );
+        else        __builtin_prefetch( p, 0, 3 );
+    }
+}
+
+#endif
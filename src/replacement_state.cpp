@@ -1,5 +1,7 @@
 #include "replacement_state.h"
 
+#include <cstring>
+
 ////////////////////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
@@ -21,6 +23,21 @@
 **
 */
 
+string crc_repl_names[ CRC_REPL_MAX ] =
+{
+    "LRU",
+    "RANDOM",
+    "SRRIP",
+    "BIP",
+    "DIP",
+    "BRRIP",
+    "DRRIP",
+    "SHIP-PC",
+    "PLRU",
+    "OPT",
+    "TADRRIP",
+    "TADIP"
+};
 
 ////////////////////////////////////////////////////////////////////////////////
 // The replacement state constructor:                                         //
@@ -31,17 +48,31 @@
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 CACHE_REPLACEMENT_STATE::CACHE_REPLACEMENT_STATE( UINT32 _sets, UINT32 _assoc, UINT32 _pol )
+    : CACHE_REPLACEMENT_STATE( _sets, _assoc, _pol, NULL )
+{
+}
+
+CACHE_REPLACEMENT_STATE::CACHE_REPLACEMENT_STATE( UINT32 _sets, UINT32 _assoc, UINT32 _pol, CRC_ARENA *_arena )
 {
 
     numsets    = _sets;
     assoc      = _assoc;
     replPolicy = _pol;
+    arena      = _arena ? _arena : &ownArena;
 
     mytimer    = 0;
 
     InitReplacementState();
 }
 
+// The per-set arrays go away with the arena
+CACHE_REPLACEMENT_STATE::~CACHE_REPLACEMENT_STATE()
+{
+    delete duel;
+    delete ship;
+    delete [] streams;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 // This function initializes the replacement policy hardware by creating      //
@@ -50,50 +81,99 @@ CACHE_REPLACEMENT_STATE::CACHE_REPLACEMENT_STATE( UINT32 _sets, UINT32 _assoc, U
 ////////////////////////////////////////////////////////////////////////////////
 void CACHE_REPLACEMENT_STATE::InitReplacementState()
 {
-    // Create the state for sets, then create the state for the ways
-    repl  = new LINE_REPLACEMENT_STATE* [ numsets ];
-    PSEL=511 ; // PSEL is 10 bit where MSB is used to select policy for follower sets
-    // ensure that we were able to create replacement state
-    assert(repl);
-    // Create the state for the sets
-    for(UINT32 setIndex=0; setIndex<numsets; setIndex++) 
-    {
-        repl[ setIndex ]  = new LINE_REPLACEMENT_STATE[ assoc ];
-	
-        for(UINT32 way=0; way<assoc; way++) 
+    // Only the per-line state of the policy is created (see
+    // CRC_ReplUsesLRUStack and CRC_ReplUsesRRPV)
+
+    // LRU stack positions, one byte per way (for true LRU and the
+    // LRU-stack family: BIP, DIP and TADIP)
+    lruAge = NULL;
+    if( CRC_ReplUsesLRUStack( replPolicy ) )
+    {
+        assert( assoc <= 256 );
+        lruAge = arena->Alloc<unsigned char>( (size_t) numsets * assoc );
+        for(UINT32 setIndex=0; setIndex<numsets; setIndex++) 
         {
-            // initialize stack position (for true LRU)
-            repl[ setIndex ][ way ].LRUstackposition = way;
-	    repl[ setIndex ][ way ].RRVPstackposition = 3 ;  // this can be set to 2^m-1 as well  // make it 3
+            for(UINT32 way=0; way<assoc; way++) 
+            {
+                // initialize stack position (for true LRU)
+                lruAge[ setIndex * assoc + way ] = way;
+            }
+        }
+    }
 
-		// SHiP initilization
-	    repl[ setIndex ][ way ].outcome = 0;
-	    repl[ setIndex ][ way ].signature_m=0;
+    // RRPVs, packed 32 ways to a word; every line starts at the distant RRPV
+    rrpvWords     = (assoc + CRC_RRPV_PER_WORD - 1) / CRC_RRPV_PER_WORD;
+    rrpvLastLanes = CRC_RRPV_LANES;
+    if( assoc % CRC_RRPV_PER_WORD )
+    {
+        rrpvLastLanes &= (1ULL << (CRC_RRPV_BITS * (assoc % CRC_RRPV_PER_WORD))) - 1;
+    }
 
+    rrpv = NULL;
+    if( CRC_ReplUsesRRPV( replPolicy ) )
+    {
+        rrpv = arena->Alloc<BITVECTOR>( (size_t) numsets * rrpvWords );
+        for(UINT32 setIndex=0; setIndex<numsets; setIndex++) 
+        {
+            for(UINT32 w=0; w<rrpvWords; w++)
+            {
+                rrpv[ setIndex * rrpvWords + w ] = RRPVLanes( w ) * CRC_RRPV_MAX;
+            }
         }
     }
 
-	for(UINT32 i=0; i<16384; i++)
-	{	
-	SHCT[i]=0;
-	}	
+    // DIP duels LRU (policy 0) against BIP (policy 1), DRRIP SRRIP against
+    // BRRIP, with 32 leader sets each and a 10-bit PSEL
+    duel         = NULL;
+    duelLeaders  = 32;
+    duelPselBits = 10;
+    numThreads   = 1;
+    InitDueling();
+
+    // Random stream, default seed until SetSeed; SetThreads adds the
+    // streams of the other threads
+    streams         = new CRC_RANDOM_STREAM[ 1 ];
+    shared          = false;
+    setStride       = 1;
+    setOffset       = 0;
+    SetSeed( CRC_RANDOM_DEFAULT_SEED );
+
+    // Fills of every set so far, for the bimodal insertion
+    bimodalFills    = NULL;
+    bimodalThrottle = false;
+    if( CRC_ReplUsesBimodal( replPolicy ) ) bimodalFills = arena->Alloc<UINT32>( numsets );
+
+    // SHiP signature table, default configuration until SetSHiPConfig,
+    // and the signatures of the lines
+    ship         = NULL;
+    shipFlags    = NULL;
+    shipSigs     = NULL;
+    shipSigBytes = 0;
+    if( replPolicy == CRC_REPL_SHIPPC )
+    {
+        ship = new SHIP_PREDICTOR( DefaultSHiPConfig() );
+        InitSHiPLines();
+    }
+
+    // Next uses for OPT; a line with no recorded next use is never reused
+    optNextUse  = NULL;
+    currNextUse = CRC_NEVER_USED;
+    optBypass   = false;
+    optBypasses = 0;
+
+    if( replPolicy == CRC_REPL_OPT )
+    {
+        optNextUse = arena->Alloc<COUNTER>( (size_t) numsets * assoc );
+        for(UINT32 i=0; i<numsets * assoc; i++) optNextUse[i] = CRC_NEVER_USED;
+    }
 
     // Contestants:  ADD INITIALIZATION FOR YOUR HARDWARE HERE
-    // PLRU initilization
-//	plru_tree = { 1, 0, 1, 1, 1, 0, 0, 0, 0, 0, 1, 0, 1, 1, 0 };
-	plru_tree = new  UINT32*[numsets] ;
-	assert(plru_tree);
-	for(UINT32 setIndex=0; setIndex<numsets; setIndex++) 
-	{
-	plru_tree[setIndex] = new UINT32[15]	;
-	for (UINT32 i = 0; i <= 14; i++) 
-	{
-		if( i==0 || i==2 || i==3 || i==4 || i==10 || i==12 || i==13)
-        	plru_tree[setIndex][i] = 1;
-		else
-		plru_tree[setIndex][i]=0;
-    	}
-	}
+    // Tree PLRU bits
+    plruTree     = NULL;
+    plruPathMask = NULL;
+    plruPathBits = NULL;
+    plruDepth    = 0;
+    if( replPolicy == CRC_REPL_PLRU ) InitPLRU();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -113,43 +193,76 @@ void CACHE_REPLACEMENT_STATE::InitReplacementState()
 ////////////////////////////////////////////////////////////////////////////////
 INT32 CACHE_REPLACEMENT_STATE::GetVictimInSet( UINT32 tid, UINT32 setIndex, const LINE_STATE *vicSet, UINT32 assoc,
                                                Addr_t PC, Addr_t paddr, UINT32 accessType )
+{
+    switch( replPolicy )
+    {
+#define CRC_REPL_CASE( P ) case P: return GetVictimInSetT<P>( tid, setIndex, vicSet, PC, paddr, accessType );
+        CRC_REPL_FOR_EACH_POLICY( CRC_REPL_CASE )
+#undef CRC_REPL_CASE
+    }
+
+    // We should never get here
+    assert(0);
+
+    return -1; // Returning -1 bypasses the LLC
+}
+
+template <UINT32 POL>
+INT32 CACHE_REPLACEMENT_STATE::GetVictimInSetT( UINT32 tid, UINT32 setIndex, const LINE_STATE *vicSet,
+                                                Addr_t PC, Addr_t paddr, UINT32 accessType )
 {
     // If no invalid lines, then replace based on replacement policy
-    if( replPolicy == CRC_REPL_LRU ) 
+    if( POL == CRC_REPL_LRU ) 
     {
         return Get_LRU_Victim( setIndex );
     }
-    else if( replPolicy == CRC_REPL_RANDOM )
+    else if( POL == CRC_REPL_RANDOM )
     {
-        return Get_Random_Victim( setIndex );
+        return Get_Random_Victim( setIndex, tid );
     }
-    else if( replPolicy == CRC_REPL_SRRIP )
+    else if( POL == CRC_REPL_SRRIP )
     {
         // Contestants:  ADD YOUR VICTIM SELECTION FUNCTION HERE
         return Get_SRRIP_Victim( setIndex );
     }
-    else if( replPolicy == CRC_REPL_BIP )
+    else if( POL == CRC_REPL_BIP )
     {
         // BIP victim selection is same as LRU ; DRRIP victim selection is exactly same as SRRIP 
         return Get_LRU_Victim( setIndex );
     }
-    else if( replPolicy == CRC_REPL_BRRIP )
+    else if( POL == CRC_REPL_DIP )
+    {
+        return Get_LRU_Victim( setIndex );      // LRU and BIP only differ in insertion
+    }
+    else if( POL == CRC_REPL_BRRIP )
     {
         return Get_SRRIP_Victim( setIndex );    // victim selection is same for SRRIP and BRRIP
 
     }
-    else if( replPolicy == CRC_REPL_DRRIP )
+    else if( POL == CRC_REPL_DRRIP )
     {
         return Get_SRRIP_Victim( setIndex );    // victim selection is same for SRRIP and BRRIP hence same for DRRIP
     }
-    else if( replPolicy == CRC_REPL_SHIPPC )
+    else if( POL == CRC_REPL_SHIPPC )
     {
         return Get_SRRIP_Victim( setIndex );    // victim selection for ship-pc is same for SRRIP 
     }
-    else if( replPolicy == CRC_REPL_PLRU )
+    else if( POL == CRC_REPL_PLRU )
     {
         return Get_PLRU_Victim( setIndex );    
     }
+    else if( POL == CRC_REPL_OPT )
+    {
+        return Get_OPT_Victim( setIndex );
+    }
+    else if( POL == CRC_REPL_TADRRIP )
+    {
+        return Get_SRRIP_Victim( setIndex );    // only the insertion is thread-aware
+    }
+    else if( POL == CRC_REPL_TADIP )
+    {
+        return Get_LRU_Victim( setIndex );      // only the insertion is thread-aware
+    }
 
 
     // We should never get here
@@ -164,24 +277,37 @@ INT32 CACHE_REPLACEMENT_STATE::GetVictimInSet( UINT32 tid, UINT32 setIndex, cons
 // The arguments are: the set index, the physical way of the cache,           //
 // the pointer to the physical line (should contestants need access           //
 // to information of the line filled or hit upon), the thread id              //
-// of the request, the PC of the request, the accesstype, and finall          //
-// whether the line was a cachehit or not (cacheHit=true implies hit)         //
+// of the request, the PC and address of the request, the accesstype, and     //
+// finally whether the line was a cachehit or not (cacheHit=true implies hit) //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 void CACHE_REPLACEMENT_STATE::UpdateReplacementState( 
     UINT32 setIndex, INT32 updateWayID, const LINE_STATE *currLine, 
-    UINT32 tid, Addr_t PC, UINT32 accessType, bool cacheHit )
+    UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType, bool cacheHit )
+{
+    switch( replPolicy )
+    {
+#define CRC_REPL_CASE( P ) case P: UpdateReplacementStateT<P>( setIndex, updateWayID, currLine, tid, PC, paddr, accessType, cacheHit ); break;
+        CRC_REPL_FOR_EACH_POLICY( CRC_REPL_CASE )
+#undef CRC_REPL_CASE
+    }
+}
+
+template <UINT32 POL>
+void CACHE_REPLACEMENT_STATE::UpdateReplacementStateT( 
+    UINT32 setIndex, INT32 updateWayID, const LINE_STATE *currLine, 
+    UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType, bool cacheHit )
 {
     // What replacement policy?
-    if( replPolicy == CRC_REPL_LRU ) 
+    if( POL == CRC_REPL_LRU ) 
     {
         UpdateLRU( setIndex, updateWayID );
     }
-    else if( replPolicy == CRC_REPL_RANDOM )
+    else if( POL == CRC_REPL_RANDOM )
     {
         // Random replacement requires no replacement state update
     }
-    else if( replPolicy == CRC_REPL_SRRIP )
+    else if( POL == CRC_REPL_SRRIP )
     {	
         // Contestants:  ADD YOUR UPDATE REPLACEMENT STATE FUNCTION HERE
         // Feel free to use any of the input parameters to make
@@ -189,30 +315,65 @@ void CACHE_REPLACEMENT_STATE::UpdateReplacementState(
         // it takes cacheHit argument to update rrpv value to 0, on miss to (assoc -1) / 2^M-1
         UpdateSRRIP(setIndex, updateWayID, cacheHit);
     }
-    else if( replPolicy == CRC_REPL_BIP )
+    else if( POL == CRC_REPL_BIP )
     {	
-        UpdateBIP(setIndex, updateWayID, cacheHit);
+        UpdateBIP(setIndex, updateWayID, cacheHit, tid);
     }   
-    else if( replPolicy == CRC_REPL_BRRIP )
+    else if( POL == CRC_REPL_DIP )
+    {
+        UpdateDIP( setIndex, updateWayID, cacheHit, tid );
+    }
+    else if( POL == CRC_REPL_BRRIP )
     {	
-        UpdateBRRIP(setIndex, updateWayID, cacheHit);
+        UpdateBRRIP(setIndex, updateWayID, cacheHit, tid);
     }
-    else if( replPolicy == CRC_REPL_DRRIP )
+    else if( POL == CRC_REPL_DRRIP )
     {	
-        UpdateDRRIP(setIndex, updateWayID, cacheHit);
+        UpdateDRRIP(setIndex, updateWayID, cacheHit, tid);
     }
-    else if( replPolicy == CRC_REPL_SHIPPC )
+    else if( POL == CRC_REPL_SHIPPC )
     {	
-        UpdateSHIPPC(setIndex, updateWayID, cacheHit, PC);
+        UpdateSHIPPC( setIndex, updateWayID, cacheHit, tid, PC, paddr );
     }
-    else if( replPolicy == CRC_REPL_PLRU )
+    else if( POL == CRC_REPL_PLRU )
     {	
-        UpdatePLRU(setIndex, updateWayID, cacheHit);
+        UpdatePLRU( setIndex, updateWayID );    // on fills as well as hits
+    }
+    else if( POL == CRC_REPL_OPT )
+    {
+        UpdateOPT( setIndex, updateWayID );
+    }
+    else if( POL == CRC_REPL_TADRRIP )
+    {
+        UpdateTADRRIP( setIndex, updateWayID, cacheHit, tid );
+    }
+    else if( POL == CRC_REPL_TADIP )
+    {
+        UpdateTADIP( setIndex, updateWayID, cacheHit, tid );
     }
 
      
 }
 
+void CACHE_REPLACEMENT_STATE::PrefetchSet( UINT32 setIndex ) const
+{
+    switch( replPolicy )
+    {
+#define CRC_REPL_CASE( P ) case P: PrefetchSetT<P>( setIndex ); break;
+        CRC_REPL_FOR_EACH_POLICY( CRC_REPL_CASE )
+#undef CRC_REPL_CASE
+    }
+}
+
+// Emit the specialized entry points for every policy
+#define CRC_REPL_INSTANTIATE( P )                                                                         \
+    template INT32 CACHE_REPLACEMENT_STATE::GetVictimInSetT<P>( UINT32, UINT32, const LINE_STATE *,       \
+                                                                Addr_t, Addr_t, UINT32 );                 \
+    template void  CACHE_REPLACEMENT_STATE::UpdateReplacementStateT<P>( UINT32, INT32, const LINE_STATE *, \
+                                                                        UINT32, Addr_t, Addr_t, UINT32, bool );
+CRC_REPL_FOR_EACH_POLICY( CRC_REPL_INSTANTIATE )
+#undef CRC_REPL_INSTANTIATE
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 //////// HELPER FUNCTIONS FOR REPLACEMENT UPDATE AND VICTIM SELECTION //////////
@@ -230,18 +391,15 @@ void CACHE_REPLACEMENT_STATE::UpdateReplacementState(
 INT32 CACHE_REPLACEMENT_STATE::Get_LRU_Victim( UINT32 setIndex )
 {
     // Get pointer to replacement state of current set
-    LINE_REPLACEMENT_STATE *replSet = repl[ setIndex ];
+    const unsigned char *ages = lruAge + setIndex * assoc;
 
     INT32   lruWay   = 0;
 
-    // Search for victim whose stack position is assoc-1
+    // Search for victim whose stack position is assoc-1; exactly one way
+    // matches, so scan without an early exit and let the loop vectorize
     for(UINT32 way=0; way<assoc; way++) 
     {
-        if( replSet[way].LRUstackposition == (assoc-1) ) 
-        {
-            lruWay = way;
-            break;
-        }
+        lruWay |= (ages[way] == (assoc-1)) ? way : 0;
     }
 
     // return lru way
@@ -250,39 +408,57 @@ INT32 CACHE_REPLACEMENT_STATE::Get_LRU_Victim( UINT32 setIndex )
 
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
-// This function finds the SRRIP victim in the cache set		      //
-// from left to right the first RRPV value with assoc-1 / 2^M-1 is returned	//
-// //
+// This function finds the SRRIP victim in the cache set                      //
+// from left to right the first RRPV value with 2^M-1 is returned. If there   //
+// is none, all RRPVs are aged in one step so that the oldest line saturates  //
+//                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 INT32 CACHE_REPLACEMENT_STATE::Get_SRRIP_Victim( UINT32 setIndex )
 {
     // Get pointer to replacement state of current set
-    LINE_REPLACEMENT_STATE *replSet = repl[ setIndex ];
+    BITVECTOR *replSet = rrpv + setIndex * rrpvWords;
 
-    INT32   srripWay   = -1;
-    INT32   rrpvSaturatedFlag = 0 ;
-    // Search for victim whose stack position is assoc-1
-    for(UINT32 way=0; way<assoc; way++) 
+    // Lines at RRPV 3 have both bits of their lane set
+    for(UINT32 w=0; w<rrpvWords; w++)
     {
-        if( replSet[way].RRVPstackposition ==  3) //assoc-1) ) 	// it could be 2^M-1
+        BITVECTOR saturated = replSet[w] & (replSet[w] >> 1) & RRPVLanes( w );
+        if( saturated )
         {
-            srripWay = way;
-	    rrpvSaturatedFlag = 1 ;
-            break;
+            return w * CRC_RRPV_PER_WORD + __builtin_ctzll( saturated ) / CRC_RRPV_BITS;
         }
     }
 
-    if( rrpvSaturatedFlag ==0 )
-	{ 
- 		for(UINT32 way=0; way<assoc; way++) 
-    		{
-        	replSet[way].RRVPstackposition++;	// increment every RRPV by 1 untill you make one of them assoc-1 or 2^M -1
-    		}
-	return Get_SRRIP_Victim( setIndex );
-	}
-		
-    // return srrip way
-    return srripWay;
+    // No line at RRPV 3: incrementing every RRPV until one of them saturates
+    // is the same as adding (3 - largest RRPV) to all of them at once. No
+    // lane can carry into its neighbour since none ends up above 3.
+    UINT32 maxRRPV = 0;
+    for(UINT32 w=0; w<rrpvWords; w++)
+    {
+        BITVECTOR hi = (replSet[w] >> 1) & RRPVLanes( w );
+        BITVECTOR lo = replSet[w] & RRPVLanes( w );
+        UINT32    m  = hi ? 2 + ((hi & lo) != 0) : (lo != 0);
+
+        if( m > maxRRPV ) maxRRPV = m;
+    }
+
+    for(UINT32 w=0; w<rrpvWords; w++)
+    {
+        replSet[w] += RRPVLanes( w ) * (CRC_RRPV_MAX - maxRRPV);
+    }
+
+    // The first way that was at the largest RRPV is now saturated
+    for(UINT32 w=0; w<rrpvWords; w++)
+    {
+        BITVECTOR saturated = replSet[w] & (replSet[w] >> 1) & RRPVLanes( w );
+        if( saturated )
+        {
+            return w * CRC_RRPV_PER_WORD + __builtin_ctzll( saturated ) / CRC_RRPV_BITS;
+        }
+    }
+
+    // We should never get here
+    assert(0);
+    return 0;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -290,37 +466,76 @@ INT32 CACHE_REPLACEMENT_STATE::Get_SRRIP_Victim( UINT32 setIndex )
 // This function finds a random victim in the cache set                       //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
-INT32 CACHE_REPLACEMENT_STATE::Get_Random_Victim( UINT32 setIndex )
+INT32 CACHE_REPLACEMENT_STATE::Get_Random_Victim( UINT32 setIndex, UINT32 tid )
 {
-    INT32 way = (rand() % assoc);
+    INT32 way = Stream( tid ).rng.Below( assoc );
     
     return way;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
-//
-//  PLRU victim selection
-//////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Tree PLRU over the next power of two of assoc leaves. For an associativity //
+// that is not a power of two (12, 20 ways) the leaves past assoc do not      //
+// exist; a node whose right subtree holds none of the ways is left out of    //
+// every path mask, so it stays 0 and the victim walk never goes there.       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::InitPLRU()
+{
+    assert( assoc <= CRC_PLRU_MAXWAYS );
+
+    plruDepth    = CRC_CeilLog2( assoc );
+    plruTree     = arena->Alloc<BITVECTOR>( numsets );     // all nodes 0
+    plruPathMask = arena->Alloc<BITVECTOR>( assoc );
+    plruPathBits = arena->Alloc<BITVECTOR>( assoc );
+
+    for(UINT32 way=0; way<assoc; way++)
+    {
+        BITVECTOR mask = 0, bits = 0;
+        UINT32    node = 0, first = 0, leaves = 1 << plruDepth;
+
+        for(UINT32 level=0; level<plruDepth; level++)
+        {
+            UINT32 mid   = first + leaves / 2;
+            bool   right = way >= mid;
+
+            if( mid < assoc )
+            {
+                mask |= 1ULL << node;
+                if( !right ) bits |= 1ULL << node;  // point away from the way
+            }
+
+            node    = 2 * node + 1 + right;
+            first   = right ? mid : first;
+            leaves /= 2;
+        }
+
+        plruPathMask[ way ] = mask;
+        plruPathBits[ way ] = bits;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// PLRU victim selection: follow the node bits from the root. Each level is   //
+// one shift and mask with no branch, at most six levels for 64 ways.         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
 INT32 CACHE_REPLACEMENT_STATE::Get_PLRU_Victim( UINT32 setIndex )
 {
+    BITVECTOR tree = plruTree[ setIndex ];
+    UINT32    node = 0;
+
+    for(UINT32 level=0; level<plruDepth; level++)
+    {
+        node = 2 * node + 1 + (UINT32) ((tree >> node) & 1);
+    }
+
+    INT32 way = node - ((1 << plruDepth) - 1);
+
+    assert( way < (INT32) assoc );
 
-// this is the implementation of Figure 5 in PLRU paper
-// traverse from root to leaf node based on plru bits 
-INT32 way;
-UINT32 i=0;
-    while (i<15)
-	{
-	if (plru_tree[setIndex][i] == 1)
-	{	
-		way=i;
-		i=(2*i)+2;
-	}
-	else
-	{
-		way=i;
-		i=(2*i)+1;
-	}
-	}
     return way;
 }
 
@@ -334,21 +549,47 @@ UINT32 i=0;
 ////////////////////////////////////////////////////////////////////////////////
 void CACHE_REPLACEMENT_STATE::UpdateLRU( UINT32 setIndex, INT32 updateWayID )
 {
+    PromoteLRU( setIndex, updateWayID );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// These functions move a line to the top (MRU) or bottom (LRU) of the LRU    //
+// stack. The loops are branch-free over the byte vector of stack positions   //
+// so that the compiler turns them into a handful of vector operations.       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::PromoteLRU( UINT32 setIndex, INT32 updateWayID )
+{
+    unsigned char *ages = lruAge + setIndex * assoc;
+
     // Determine current LRU stack position
-    UINT32 currLRUstackposition = repl[ setIndex ][ updateWayID ].LRUstackposition;
+    unsigned char currLRUstackposition = ages[ updateWayID ];
 
     // Update the stack position of all lines before the current line
     // Update implies incremeting their stack positions by one
     for(UINT32 way=0; way<assoc; way++) 
     {
-        if( repl[setIndex][way].LRUstackposition < currLRUstackposition ) 
-        {
-            repl[setIndex][way].LRUstackposition++;
-        }
+        ages[way] += (ages[way] < currLRUstackposition);
     }
 
     // Set the LRU stack position of new line to be zero
-    repl[ setIndex ][ updateWayID ].LRUstackposition = 0;
+    ages[ updateWayID ] = 0;
+}
+
+void CACHE_REPLACEMENT_STATE::DemoteLRU( UINT32 setIndex, INT32 updateWayID )
+{
+    unsigned char *ages = lruAge + setIndex * assoc;
+
+    unsigned char currLRUstackposition = ages[ updateWayID ];
+
+    // Lines below the current line move up by one
+    for(UINT32 way=0; way<assoc; way++) 
+    {
+        ages[way] -= (ages[way] > currLRUstackposition);
+    }
+
+    ages[ updateWayID ] = assoc - 1;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -363,12 +604,12 @@ void CACHE_REPLACEMENT_STATE::UpdateSRRIP( UINT32 setIndex, INT32 updateWayID, b
 {
         if( cacheHit ==1 ) 
         {
-		 repl[ setIndex ][ updateWayID ].RRVPstackposition = 0;
+		 SetRRPV( setIndex, updateWayID, 0 );
 
         }
 	else 
 	{
-		 repl[ setIndex ][ updateWayID ].RRVPstackposition = 2 ; //assoc - 1 ;    /// make it 2
+		 SetRRPV( setIndex, updateWayID, CRC_RRPV_LONG );
 	}
     
 
@@ -376,21 +617,22 @@ void CACHE_REPLACEMENT_STATE::UpdateSRRIP( UINT32 setIndex, INT32 updateWayID, b
 //
 // is update policy for BRRIP same ?
 ////////////////////////////////////////////////////////////////////////////////
-void CACHE_REPLACEMENT_STATE::UpdateBRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit )
+void CACHE_REPLACEMENT_STATE::UpdateBRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid )
 {
 
-    bool  episilon = (rand() % 31 == 0); 
+    // only fills draw, so the throttle counts fills
+    bool  episilon = !cacheHit && BimodalDraw( setIndex ); 
         if( cacheHit ==1 ) 
         {
-		 repl[ setIndex ][ updateWayID ].RRVPstackposition = 0;
+		 SetRRPV( setIndex, updateWayID, 0 );
 
         }
 	else 
 	{
 	if( episilon ==0 )
-		 repl[ setIndex ][ updateWayID ].RRVPstackposition = 2 ; // assoc - 2 ;  /// 2
+		 SetRRPV( setIndex, updateWayID, CRC_RRPV_LONG );
 	else
-		 repl[ setIndex ][ updateWayID ].RRVPstackposition = 3 ; //assoc - 1 ;  /// 3
+		 SetRRPV( setIndex, updateWayID, CRC_RRPV_MAX );
 	}
 
 //if( episilon == 31)
@@ -401,80 +643,245 @@ void CACHE_REPLACEMENT_STATE::UpdateBRRIP( UINT32 setIndex, INT32 updateWayID, b
 
 }
 ////////////////////////////////////////////////////////////////////////////////
-// is update policy for DRRIP
-// ////////////////////////////////////////////////////////////////////////////////
-void CACHE_REPLACEMENT_STATE::UpdateDRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit)   // put PSEL here
-{
-UINT32 setIndex9to5 , setIndex4to0, InvsetIndex9to5 ;
-////////// InvsetIndex9to5 selects the constituency and InvsetIndex9to5 selects the offset
-setIndex9to5 = (setIndex & 992 ) ; // 1111100000 = 992 
-setIndex4to0 = (setIndex & 31 ) ; // 0000011111 = 31 
-InvsetIndex9to5 = (~setIndex9to5 & 1023)>>5 ;       // used to compare if 9to5 is compliment of 4to0 bits 
-bool srrip_pol = (setIndex9to5>>5 == setIndex4to0);  // for SRRIP dedicated sets
-bool brrip_pol = (InvsetIndex9to5 == setIndex4to0) ; // for BRRIP dedicated sets
-bool psel_msb = ( PSEL > 511) ;
-	if ( srrip_pol==0 && brrip_pol==0)
-	{	// for follower sets
-		if(!psel_msb)                                                   // not of psel
-			UpdateSRRIP( setIndex, updateWayID, cacheHit);
-		else 
-			UpdateBRRIP( setIndex, updateWayID, cacheHit);
-	}
-		// for srrip sets
-	else if (srrip_pol==1)
-			{
-			UpdateSRRIP( setIndex, updateWayID, cacheHit);
-			if(PSEL<1023 && !cacheHit)
-			PSEL++ ;
-			}
-		// for brrip sets
-	else if (brrip_pol ==1)
-			{
-			UpdateBRRIP( setIndex, updateWayID, cacheHit);
-			if(PSEL>0 && !cacheHit)
-			PSEL--;
-			}
-
-}
-////////////////////////////////////////////////////////////////////////////////
-////////////////////////////////////////////////////////////////////////////////
-// is update policy for DRRIP
-// ////////////////////////////////////////////////////////////////////////////////
-void CACHE_REPLACEMENT_STATE::UpdateSHIPPC( UINT32 setIndex, INT32 updateWayID, bool cacheHit, Addr_t PC)  
-{
-	// hashing the PC address, right now taking only last 14 bits, have to do collision analysis if not doing hashing
-	// take saturating counter of width 3 for shct counter 
-	UINT32 SHCT_index= ((UINT32)PC) & 16383 ;		// gettin gthe signature from PC
-
-///	implementation of figure 1 (b) SHiP algorithm
-	if(cacheHit)
-		{
-		repl[ setIndex ][ updateWayID ].outcome = 1 ;
-		if(SHCT[repl[ setIndex ][ updateWayID ].signature_m]<8)
-		{
-		SHCT[repl[ setIndex ][ updateWayID ].signature_m]++;
-		}
-		repl[ setIndex ][ updateWayID ].RRVPstackposition = 0 ;			// promotion
-		}
-	else 
-		{
-	        if(repl[ setIndex ][ updateWayID ].outcome==0)
-			{
-			if(SHCT[repl[ setIndex ][ updateWayID ].signature_m]>0)
-			SHCT[repl[ setIndex ][ updateWayID ].signature_m]--;
-			}
-		repl[ setIndex ][ updateWayID ].signature_m = SHCT_index;
-		repl[ setIndex ][ updateWayID ].outcome = 0;			
-		if (SHCT[SHCT_index] == 0)
-		{
-			repl[ setIndex ][ updateWayID ].RRVPstackposition = 3 ; 	// distant reference	
-		} 
-		else
-		{ 
-			repl[ setIndex ][ updateWayID ].RRVPstackposition = 2 ;		// intermediate reference
-		}
-		}
-		
+//                                                                            //
+// DIP (Qureshi et al., ISCA'07): leader sets always insert with LRU (at MRU) //
+// or BIP and their misses train the selector; follower sets insert with the  //
+// current winner, so scans stop flushing the cache once BIP misses less      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::UpdateDIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid )
+{
+    if( duel->Policy( setIndex ) == 0 )
+        UpdateLRU( setIndex, updateWayID );
+    else
+        UpdateBIP( setIndex, updateWayID, cacheHit, tid );
+
+    if( !cacheHit ) DuelingMiss( setIndex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// DRRIP: leader sets always insert with SRRIP or BRRIP and their misses      //
+// train the selector; follower sets insert with the current winner           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::UpdateDRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid )
+{
+    if( duel->Policy( setIndex ) == 0 )
+        UpdateSRRIP( setIndex, updateWayID, cacheHit );
+    else
+        UpdateBRRIP( setIndex, updateWayID, cacheHit, tid );
+
+    if( !cacheHit ) DuelingMiss( setIndex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// TA-DRRIP (Jaleel et al., PACT'08 and ISCA'10): DRRIP with one selector per //
+// thread, so a thrashing thread gets BRRIP insertion without forcing it on   //
+// the threads whose working sets fit                                         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::UpdateTADRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid )
+{
+    assert( tid < numThreads );
+
+    if( duel->Policy( setIndex, tid ) == 0 )
+        UpdateSRRIP( setIndex, updateWayID, cacheHit );
+    else
+        UpdateBRRIP( setIndex, updateWayID, cacheHit, tid );
+
+    if( !cacheHit ) DuelingMiss( setIndex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// TADIP (Jaleel et al., PACT'08), in its feedback form TADIP-F: DIP with one //
+// selector per thread, each thread dueling LRU against BIP insertion in      //
+// leader sets of its own                                                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::UpdateTADIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid )
+{
+    assert( tid < numThreads );
+
+    if( duel->Policy( setIndex, tid ) == 0 )
+        UpdateLRU( setIndex, updateWayID );
+    else
+        UpdateBIP( setIndex, updateWayID, cacheHit, tid );
+
+    if( !cacheHit ) DuelingMiss( setIndex );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function (re)creates the set dueling selector of the dueling policies  //
+// from the current configuration                                             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::InitDueling()
+{
+    delete duel;
+    duel = NULL;
+
+    if( replPolicy == CRC_REPL_DIP || replPolicy == CRC_REPL_DRRIP )
+    {
+        duel = new SET_DUELING( numsets, 2, duelLeaders, duelPselBits );
+    }
+    else if( replPolicy == CRC_REPL_TADRRIP || replPolicy == CRC_REPL_TADIP )
+    {
+        duel = new SET_DUELING( numsets, 2, duelLeaders, duelPselBits, numThreads );
+    }
+}
+
+// Labels of the dueling policies for the statistics
+void CACHE_REPLACEMENT_STATE::DuelingNames( string *names ) const
+{
+    if( replPolicy == CRC_REPL_DIP || replPolicy == CRC_REPL_TADIP )
+    {
+        names[0] = crc_repl_names[ CRC_REPL_LRU ];
+        names[1] = crc_repl_names[ CRC_REPL_BIP ];
+    }
+    else
+    {
+        names[0] = crc_repl_names[ CRC_REPL_SRRIP ];
+        names[1] = crc_repl_names[ CRC_REPL_BRRIP ];
+    }
+}
+
+void CACHE_REPLACEMENT_STATE::SetDuelingConfig( UINT32 leaders, UINT32 pselBits )
+{
+    duelLeaders  = leaders;
+    duelPselBits = pselBits;
+    InitDueling();
+}
+
+void CACHE_REPLACEMENT_STATE::SetThreads( UINT32 threads )
+{
+    numThreads = threads;
+    InitDueling();
+
+    delete [] streams;
+    streams = new CRC_RANDOM_STREAM[ numThreads ];
+    SetSeed( seed );
+}
+
+// The streams of the shards of a CRC_PARALLEL_CACHE are all different
+void CACHE_REPLACEMENT_STATE::SetSeed( BITVECTOR _seed )
+{
+    seed = _seed;
+
+    for(UINT32 t=0; t<numThreads; t++) streams[t].rng.Seed( seed + (BITVECTOR) t * setStride + setOffset );
+}
+
+void CACHE_REPLACEMENT_STATE::SetShard( UINT32 shard, UINT32 shards )
+{
+    assert( shard < shards );
+
+    setStride = shards;
+    setOffset = shard;
+    SetSeed( seed );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Shared mode. Everything per set is protected by the cache's set locks;     //
+// what is left is the state of the whole cache. The random streams become    //
+// per thread, which keeps shared runs reproducible when the accesses are     //
+// issued in a fixed order. OPT hands the next use of the current access in   //
+// through one member and cannot be shared.                                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::EnableSharedAccess()
+{
+    assert( replPolicy != CRC_REPL_OPT );
+
+    shared = true;
+}
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// SHiP update (figure 1(b) of the SHiP paper): a hit trains the signature    //
+// of the line up and promotes it; a fill first trains the signature of the   //
+// evicted line down if it was never reused, then inserts the new line at     //
+// the distant RRPV if its own signature predicts no reuse                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::UpdateSHIPPC( UINT32 setIndex, INT32 updateWayID, bool cacheHit,
+                                            UINT32 tid, Addr_t PC, Addr_t paddr )
+{
+    BITVECTOR *flags = shipFlags + (size_t) setIndex * SHIP_LINE_FLAGS;
+    BITVECTOR  bit   = 1ULL << updateWayID;
+    size_t     line  = (size_t) setIndex * assoc + updateWayID;
+
+    CRC_SPIN_GUARD guard( PolicyLock() );
+
+    if( cacheHit )
+    {
+        if( flags[ SHIP_LINE_SIGNED ] & bit ) ship->Hit( GetSHiPSignature( line ) );
+        ship->Advance( tid, PC );
+
+        flags[ SHIP_LINE_REUSED ] |= bit;
+        SetRRPV( setIndex, updateWayID, 0 );            // promotion
+    }
+    else
+    {
+        if( flags[ SHIP_LINE_SIGNED ] & bit )
+        {
+            ship->Evict( GetSHiPSignature( line ), flags[ SHIP_LINE_REUSED ] & bit, flags[ SHIP_LINE_DISTANT ] & bit );
+        }
+
+        UINT32 signature = ship->Signature( tid, PC, paddr );
+        bool   distant   = ship->PredictDistant( signature );
+
+        SetSHiPSignature( line, signature );
+        flags[ SHIP_LINE_SIGNED ]  |= bit;
+        flags[ SHIP_LINE_REUSED ]  &= ~bit;
+        flags[ SHIP_LINE_DISTANT ]  = distant ? (flags[ SHIP_LINE_DISTANT ] | bit) : (flags[ SHIP_LINE_DISTANT ] & ~bit);
+
+        // distant or intermediate re-reference
+        SetRRPV( setIndex, updateWayID, distant ? CRC_RRPV_MAX : CRC_RRPV_LONG );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function creates the line state of SHiP for the current predictor:     //
+// signatures as narrow as its table allows, and flags that say no line has   //
+// a signature yet                                                            //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::InitSHiPLines()
+{
+    UINT32 sigBytes = ship->Signatures() <= 65536 ? 2 : 4;
+
+    assert( assoc <= CRC_SHIP_MAXWAYS );
+
+    if( shipFlags == NULL ) shipFlags = arena->Alloc<BITVECTOR>( (size_t) numsets * SHIP_LINE_FLAGS );
+    else                    memset( shipFlags, 0, (size_t) numsets * SHIP_LINE_FLAGS * sizeof(BITVECTOR) );
+
+    // The signatures need not be cleared, nothing reads them unsigned;
+    // a wider table than before needs a new array
+    if( sigBytes > shipSigBytes )
+    {
+        shipSigs     = arena->Alloc( (size_t) numsets * assoc * sigBytes );
+        shipSigBytes = sigBytes;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function replaces the SHiP predictor. Lines already in the cache lose  //
+// their signatures, which were entries of the old table, so this is only     //
+// meaningful before any access.                                              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::SetSHiPConfig( const SHIP_CONFIG &config )
+{
+    if( replPolicy != CRC_REPL_SHIPPC ) return;
+
+    delete ship;
+    ship = new SHIP_PREDICTOR( config );
+    InitSHiPLines();
 }
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
@@ -484,76 +891,62 @@ void CACHE_REPLACEMENT_STATE::UpdateSHIPPC( UINT32 setIndex, INT32 updateWayID,
 // BIP : With low probability episilon insert at MRU position  - Qureshi section 4. para 3 //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
-void CACHE_REPLACEMENT_STATE::UpdateBIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit )
+void CACHE_REPLACEMENT_STATE::UpdateBIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid )
 {
- // Determine current LRU stack position
-    UINT32 currLRUstackposition = repl[ setIndex ][ updateWayID ].LRUstackposition;
-       
-// epison is probability with which insertion takes place
-    bool episilon ; episilon = (rand() % 31 == 0); 
+// epison is probability with which insertion takes place; only fills draw
+    bool episilon = !cacheHit && BimodalDraw( setIndex ); 
 	//
 	// On cache hit means reference ; we just need to make lru stackposition vlaue 0 and change others accordingly 
-	if( cacheHit ==1 )
+	// With probability episilon a new line is inserted at MRU as well
+	if( cacheHit ==1 || episilon ==1 )
         {
-		for(UINT32 way=0; way<assoc; way++)
-			{	if(repl[setIndex][way].LRUstackposition < currLRUstackposition)
-				{
-					repl[ setIndex ][ way ].LRUstackposition++;
-				}
-			}
-    		
-		repl[ setIndex ][ updateWayID ].LRUstackposition = 0;
-	}
-
-	else if(episilon ==1)  
-	{	repl[setIndex][updateWayID].LRUstackposition = 0 ;
-		for(UINT32 way=0; way<assoc; way++)
-		{	if(int(way) != updateWayID)
-			{	repl[setIndex][way].LRUstackposition++ ;
-			}
-		}
+		PromoteLRU( setIndex, updateWayID );
 	}
 
 	else 
-		repl[setIndex][updateWayID].LRUstackposition = assoc -1 ; /// make it 2 bit ?	
+		DemoteLRU( setIndex, updateWayID );
 		// this is by default, actually victim is selected from assoc -1 place,
-		// so this is from assoc -1 place only
+		// so a replaced line is already at assoc -1; a line filled into an
+		// invalid way is moved there and the lines below it shift up
 }    
 ////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Belady's OPT: evict the line whose next use is furthest in the future, or  //
+// bypass the missing line if it is reused even later than all of them        //
+//                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
-void CACHE_REPLACEMENT_STATE::UpdatePLRU( UINT32 setIndex, INT32 updateWayID, bool cacheHit)
+INT32 CACHE_REPLACEMENT_STATE::Get_OPT_Victim( UINT32 setIndex )
 {
-//// Used arrays to to implement the plru bits of each cache index
-UINT32 node = updateWayID;  // fig 6 ;    while ( p is not the root) 
-UINT32 plru_index ;
-UINT32 left_child=-1 ; // 1 imples left child, 0 implies right child, -1 imples end node 
-UINT32 parent_node_offset = 15 ; // for first iteration in while loop, sub 15 from  
-//	if(node>7)
-//	node=node-7;
+    const COUNTER *nextUse = optNextUse + setIndex * assoc;
 
-	if(cacheHit)
-	{
-	node= updateWayID + parent_node_offset ;		// this the arithematic I developed by extending the plru tree so that it can be used to calculate the plru array index iteratively. The offset to be added to wayID to get the next left node of the extended tree is 15  
-	while(node!=0)
-	{
-	if(node % 2 == 1)  // if p is a left child, (here result =1 imples left child) 
-		{	
-		left_child=1;
-		}
-	plru_index = (node-1)/2;	// finding the parent index
-	if(left_child==1)
-		{	
-		plru_tree[setIndex][plru_index]=1;
-		}
-	else if(left_child==0)
-		{
-		plru_tree[setIndex][plru_index]=0;
-		}
-	node = plru_index ;			   
-//	parent_node_offset = parent_node_offset>>1;
-	}
-	}
+    assert( optNextUse );
+
+    INT32   vicWay  = 0;
+    COUNTER vicNext = nextUse[0];
+
+    for(UINT32 way=1; way<assoc; way++)
+    {
+        if( nextUse[way] > vicNext )
+        {
+            vicWay  = way;
+            vicNext = nextUse[way];
+        }
+    }
+
+    if( optBypass && currNextUse > vicNext )
+    {
+        optBypasses++;
+        return -1;
+    }
+
+    return vicWay;
 }
+
+void CACHE_REPLACEMENT_STATE::UpdateOPT( UINT32 setIndex, INT32 updateWayID )
+{
+    optNextUse[ setIndex * assoc + updateWayID ] = currNextUse;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 //                                                                            //
 // The function prints the statistics for the cache                           //
@@ -566,9 +959,136 @@ ostream & CACHE_REPLACEMENT_STATE::PrintStats(ostream &out)
     out<<"=========== Replacement Policy Statistics ================"<<endl;
     out<<"=========================================================="<<endl;
 
+    if( replPolicy == CRC_REPL_OPT && optBypass )
+    {
+        out<<"OPT Bypasses:   "<<optBypasses<<endl;
+    }
+
+    if( ship ) ship->PrintStats( out );
+
+    if( duel )
+    {
+        string names[2];
+        DuelingNames( names );
+        duel->PrintStats( out, names, "Thread" );
+    }
+
     // CONTESTANTS:  Insert your statistics printing here
 
     return out;
     
 }
 
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Checkpoints. The policy only has the arrays it reads, and those are        //
+// saved: the LRU stack for LRU, BIP, DIP and TADIP, the RRPVs for the RRIP  //
+// family and SHiP, the fill counts of the bimodal policies, the tree bits    //
+// for PLRU and the line flags and signatures for SHiP.                       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CACHE_REPLACEMENT_STATE::Save( CRC_CHECKPOINT_WRITER *ckpt ) const
+{
+    assert( replPolicy != CRC_REPL_OPT );
+
+    COUNTER counters[2] = { mytimer, optBypasses };
+
+    ckpt->Section( CKPT_REPL_COUNTERS, counters, sizeof(counters) );
+    ckpt->Section( CKPT_REPL_STREAMS, streams, numThreads * sizeof(CRC_RANDOM_STREAM) );
+
+    if( lruAge )
+    {
+        ckpt->Section( CKPT_REPL_LRU, lruAge, (size_t) numsets * assoc );
+    }
+
+    if( rrpv )
+    {
+        ckpt->Section( CKPT_REPL_RRPV, rrpv, (size_t) numsets * rrpvWords * sizeof(BITVECTOR) );
+    }
+
+    if( bimodalFills ) ckpt->Section( CKPT_REPL_BIMODAL, bimodalFills, numsets * sizeof(UINT32) );
+
+    if( plruTree ) ckpt->Section( CKPT_REPL_PLRU, plruTree, numsets * sizeof(BITVECTOR) );
+
+    if( ship )
+    {
+        ckpt->BeginSection( CKPT_REPL_LINES, SHiPLineBytes() );
+        ckpt->Append( shipFlags, (size_t) numsets * SHIP_LINE_FLAGS * sizeof(BITVECTOR) );
+        ckpt->Append( shipSigs, (size_t) numsets * assoc * shipSigBytes );
+
+        ship->Save( ckpt );
+    }
+
+    if( duel ) duel->Save( ckpt );
+}
+
+bool CACHE_REPLACEMENT_STATE::Restore( CRC_CHECKPOINT_READER *ckpt )
+{
+    assert( replPolicy != CRC_REPL_OPT );
+
+    COUNTER counters[2];
+
+    if( !ckpt->Read( CKPT_REPL_COUNTERS, counters, sizeof(counters) )
+        || !ckpt->Read( CKPT_REPL_STREAMS, streams, numThreads * sizeof(CRC_RANDOM_STREAM) ) )
+    {
+        return false;
+    }
+
+    mytimer     = counters[0];
+    optBypasses = counters[1];
+
+    if( lruAge )
+    {
+        if( !ckpt->Read( CKPT_REPL_LRU, lruAge, (size_t) numsets * assoc ) ) return false;
+    }
+
+    if( rrpv )
+    {
+        if( !ckpt->Read( CKPT_REPL_RRPV, rrpv, (size_t) numsets * rrpvWords * sizeof(BITVECTOR) ) ) return false;
+    }
+
+    if( bimodalFills && !ckpt->Read( CKPT_REPL_BIMODAL, bimodalFills, numsets * sizeof(UINT32) ) ) return false;
+
+    if( plruTree && !ckpt->Read( CKPT_REPL_PLRU, plruTree, numsets * sizeof(BITVECTOR) ) ) return false;
+
+    if( ship )
+    {
+        size_t      flagBytes = (size_t) numsets * SHIP_LINE_FLAGS * sizeof(BITVECTOR);
+        const char *lines     = (const char *) ckpt->Section( CKPT_REPL_LINES, SHiPLineBytes() );
+
+        if( lines == NULL ) return false;
+        memcpy( shipFlags, lines, flagBytes );
+        memcpy( shipSigs, lines + flagBytes, (size_t) numsets * assoc * shipSigBytes );
+
+        if( !ship->Restore( ckpt ) ) return false;
+    }
+
+    if( duel && !duel->Restore( ckpt ) ) return false;
+
+    return true;
+}
+
+void CACHE_REPLACEMENT_STATE::ResetStats()
+{
+    optBypasses = 0;
+
+    if( ship ) ship->ResetStats();
+    if( duel ) duel->ResetStats();
+}
+
+void CACHE_REPLACEMENT_STATE::RegisterStats( CRC_STATS_REGISTRY *registry )
+{
+    if( replPolicy == CRC_REPL_OPT && optBypass ) registry->Register( "opt.bypasses", &optBypasses );
+
+    if( ship ) ship->RegisterStats( registry );
+
+    if( duel )
+    {
+        string names[2];
+        DuelingNames( names );
+        duel->RegisterStats( registry, names, "thread" );
+    }
+
+    // CONTESTANTS:  Register your statistics here
+}
+
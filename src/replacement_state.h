@@ -20,6 +20,14 @@
 #include <cassert>
 #include "utils.h"
 #include "crc_cache_defs.h"
+#include "next_use.h"
+#include "ship_predictor.h"
+#include "set_dueling.h"
+#include "crc_random.h"
+#include "spin_lock.h"
+#include "prefetch.h"
+#include "checkpoint.h"
+#include "arena.h"
 
 // Replacement Policies Supported
 typedef enum 
@@ -32,35 +40,87 @@ typedef enum
     CRC_REPL_BRRIP = 5,
     CRC_REPL_DRRIP = 6,
     CRC_REPL_SHIPPC = 7,
-    CRC_REPL_PLRU = 8
+    CRC_REPL_PLRU = 8,
+    CRC_REPL_OPT = 9,
+    CRC_REPL_TADRRIP = 10,
+    CRC_REPL_TADIP = 11,
+    CRC_REPL_MAX = 12
 } ReplacemntPolicy;
 
-// Replacement State Per Cache Line
-typedef struct
+extern string crc_repl_names[ CRC_REPL_MAX ];
+
+// Every policy the replacement state can be specialized for at compile time
+#define CRC_REPL_FOR_EACH_POLICY( X ) \
+    X( CRC_REPL_LRU )                 \
+    X( CRC_REPL_RANDOM )              \
+    X( CRC_REPL_SRRIP )               \
+    X( CRC_REPL_BIP )                 \
+    X( CRC_REPL_DIP )                 \
+    X( CRC_REPL_BRRIP )               \
+    X( CRC_REPL_DRRIP )               \
+    X( CRC_REPL_SHIPPC )              \
+    X( CRC_REPL_PLRU )                \
+    X( CRC_REPL_OPT )                 \
+    X( CRC_REPL_TADRRIP )             \
+    X( CRC_REPL_TADIP )
+
+// Re-reference prediction values (SRRIP, BRRIP, DRRIP, TA-DRRIP, SHiP-PC)
+#define CRC_RRPV_BITS     2
+#define CRC_RRPV_MAX      3                     // distant re-reference
+#define CRC_RRPV_LONG     2                     // long re-reference
+#define CRC_RRPV_PER_WORD 32                    // 2-bit RRPVs per BITVECTOR
+#define CRC_RRPV_LANES    0x5555555555555555ULL // low bit of every RRPV
+
+// BIP and BRRIP take the rare insertion once in this many fills
+#define CRC_BIMODAL_PERIOD 32
+
+// Tree PLRU: the assoc-1 node bits of a set live in one BITVECTOR
+#define CRC_PLRU_MAXWAYS  64
+
+// SHiP line flags, one BITVECTOR of them per set with a bit per way
+#define CRC_SHIP_MAXWAYS  64
+
+enum ShipLineFlag
+{
+    SHIP_LINE_SIGNED    = 0,    // the line has a signature
+    SHIP_LINE_REUSED    = 1,    // hit since it was filled (the outcome)
+    SHIP_LINE_DISTANT   = 2,    // inserted at the distant RRPV
+    SHIP_LINE_FLAGS     = 3
+};
+
+// The per-line state of each policy; nothing else is allocated
+static constexpr bool CRC_ReplUsesLRUStack( UINT32 pol )
+{
+    return pol == CRC_REPL_LRU || pol == CRC_REPL_BIP || pol == CRC_REPL_DIP || pol == CRC_REPL_TADIP;
+}
+
+static constexpr bool CRC_ReplUsesRRPV( UINT32 pol )
+{
+    return pol == CRC_REPL_SRRIP || pol == CRC_REPL_BRRIP || pol == CRC_REPL_DRRIP
+        || pol == CRC_REPL_TADRRIP || pol == CRC_REPL_SHIPPC;
+}
+
+static constexpr bool CRC_ReplUsesBimodal( UINT32 pol )
+{
+    return pol == CRC_REPL_BIP || pol == CRC_REPL_DIP || pol == CRC_REPL_BRRIP
+        || pol == CRC_REPL_DRRIP || pol == CRC_REPL_TADRRIP || pol == CRC_REPL_TADIP;
+}
+
+// Random stream of the randomized decisions; a line of its own so that
+// per-thread streams do not collide
+struct alignas(CRC_CACHE_LINE) CRC_RANDOM_STREAM
 {
-    UINT32  LRUstackposition;
-    UINT32  RRVPstackposition;		// used in SRRIP, BRRIP and DRRIP
-// For SHiP - outcome and signature_m 
-    bool  outcome;
-    UINT32 signature_m ;
-    // CONTESTANTS: Add extra state per cache line here
-
-} LINE_REPLACEMENT_STATE;
-//// node for tree based PLRU 
-//struct node
-//{
-//    UINT32 plrubit;
-//    node* left;
-//    node* right;
-//};
+    CRC_RANDOM  rng;
+};
+
+// Replacement State Per Cache Line
 //
-//Node* newNode(int data)
-//{
-//    Node* node = new Node;
-//    node->data = data;
-//    node->left = node->right = NULL;
-//    return node;
-//}
+// There is no per-line struct: every policy keeps its per-line state in
+// packed per-set arrays of its own (lruAge, rrpv, shipFlags/shipSigs,
+// plruTree, optNextUse below), only allocated for the policies that read
+// them, so that whole sets can be aged and searched with a few word
+// operations and the state of a big cache stays small.
+// CONTESTANTS: add the per-line state of your policy the same way.
 ///////////////////////////////////////
 // The implementation for the cache replacement policy
 class CACHE_REPLACEMENT_STATE
@@ -70,11 +130,69 @@ class CACHE_REPLACEMENT_STATE
     UINT32 numsets;
     UINT32 assoc;
     UINT32 replPolicy;
-    UINT32 SHCT[16384];				// For SHCT table 
-    LINE_REPLACEMENT_STATE   **repl;
-	UINT32 PSEL ;				// for set-dueling in DRRIP
-	UINT32 **plru_tree ;			// pointer for plru array
+    // Per-set state lives in arena: the cache's, or ownArena when the state
+    // is built on its own
+    CRC_ARENA                 ownArena;
+    CRC_ARENA                *arena;
+    unsigned char  *lruAge;     // LRU stack position of every way, assoc bytes per set
+    BITVECTOR      *rrpv;       // 2-bit RRPVs, rrpvWords words per set
+    UINT32          rrpvWords;
+    BITVECTOR       rrpvLastLanes;  // RRPV lanes in use in the last word of a set
+    // Set dueling of DIP and TADIP (LRU vs BIP), DRRIP and TA-DRRIP (SRRIP
+    // vs BRRIP); TADIP and TA-DRRIP have one selector per thread
+    SET_DUELING    *duel;
+    UINT32          duelLeaders;
+    UINT32          duelPselBits;
+    UINT32          numThreads;
+
+    // Tree PLRU (only allocated for CRC_REPL_PLRU): one word of node bits
+    // per set, nodes in heap order with node 0 the root; a set bit points
+    // to the right subtree. plruPathMask/plruPathBits hold, per way, the
+    // nodes on the way's path and the values that point away from it.
+    BITVECTOR      *plruTree;
+    BITVECTOR      *plruPathMask;
+    BITVECTOR      *plruPathBits;
+    UINT32          plruDepth;
     COUNTER mytimer;  // tracks # of references to the cache
+
+    // Random victims draw from a random stream. Stream 0 serves the whole
+    // cache, except in shared mode where thread t draws from stream t,
+    // seeded with seed + t.
+    CRC_RANDOM_STREAM *streams;     // one per thread
+    BITVECTOR       seed;
+
+    // The bimodal insertion is a function of the set and of the number of
+    // fills of the set so far (bimodalFills, only allocated for the bimodal
+    // policies): a hash of both with the seed, or with bimodalThrottle every
+    // CRC_BIMODAL_PERIOD-th fill. Either way it does not depend on the other
+    // sets, so a set gives the same insertions in a shard of a
+    // CRC_PARALLEL_CACHE, whose set s is set s * setStride + setOffset of
+    // the whole cache.
+    UINT32         *bimodalFills;
+    bool            bimodalThrottle;
+    UINT32          setStride;
+    UINT32          setOffset;
+
+    // Shared mode: the cache-wide state (set dueling selectors, SHiP table)
+    // is only updated under policyLock
+    bool                  shared;
+    CRC_PADDED_SPIN_LOCK  policyLock;
+
+    // SHiP signature table (only allocated for CRC_REPL_SHIPPC), and the
+    // state of every line: SHIP_LINE_FLAGS words of ShipLineFlag bits per
+    // set, and the signature (an entry of the table) of every line in 16
+    // bits, or 32 for tables of more than 64K entries
+    SHIP_PREDICTOR *ship;
+    BITVECTOR      *shipFlags;
+    void           *shipSigs;
+    UINT32          shipSigBytes;
+
+    // Belady/OPT: trace position of the next use of every line (only
+    // allocated for CRC_REPL_OPT) and of the access being handled
+    COUNTER        *optNextUse;
+    COUNTER         currNextUse;
+    bool            optBypass;
+    COUNTER         optBypasses;
     // CONTESTANTS:  Add extra state for cache here
 
   public:
@@ -82,21 +200,182 @@ class CACHE_REPLACEMENT_STATE
     // The constructor CAN NOT be changed
     CACHE_REPLACEMENT_STATE( UINT32 _sets, UINT32 _assoc, UINT32 _pol) ; //, UINT32 _PSEL );
 
+    // Same, with the per-set state allocated from the arena of the cache,
+    // which must outlive the replacement state
+    CACHE_REPLACEMENT_STATE( UINT32 _sets, UINT32 _assoc, UINT32 _pol, CRC_ARENA *_arena );
+    ~CACHE_REPLACEMENT_STATE();
+
     INT32  GetVictimInSet( UINT32 tid, UINT32 setIndex, const LINE_STATE *vicSet, UINT32 assoc, Addr_t PC, Addr_t paddr, UINT32 accessType );
     void   UpdateReplacementState( UINT32 setIndex, INT32 updateWayID );
 
     void   SetReplacementPolicy( UINT32 _pol ) { replPolicy = _pol; } 
+
+    // Restart the random streams (crc_random.h) from a seed
+    void   SetSeed( BITVECTOR _seed );
+
+    // Make the bimodal insertion of BIP and BRRIP deterministic
+    void   SetBimodalThrottle( bool throttle ) { bimodalThrottle = throttle; }
+
+    // The sets are shard shard of shards of a bigger cache (see setStride)
+    void   SetShard( UINT32 shard, UINT32 shards );
     void   IncrementTimer() { mytimer++; } 
 
+    // The cache keeps its lines in a flat tag store and only builds the
+    // LINE_STATE views (vicSet, currLine) when the policy reads them;
+    // otherwise NULL is passed. CONTESTANTS: return true if yours does.
+    bool   UsesLineState() const { return false; }
+
+    // True for the sets dedicated to one policy for set dueling. A sampled
+    // cache always simulates these so that the policy choice still trains.
+    bool   IsLeaderSet( UINT32 setIndex ) const { return duel && duel->IsLeader( setIndex ); }
+
+    // Replaces the set dueling selector with one of leaders leader sets per
+    // policy and a pselBits-wide PSEL (set_dueling.h). Call before the first
+    // access.
+    void   SetDuelingConfig( UINT32 leaders, UINT32 pselBits );
+    SET_DUELING * Dueling() { return duel; }
+
+    // Threads sharing the cache, for the thread-aware policies. CRC_CACHE
+    // sets this right after construction.
+    void   SetThreads( UINT32 threads );
+
+    // Shared mode (CRC_CACHE::EnableSharedAccess): different sets may be
+    // updated concurrently by several threads, as long as every tid is
+    // issued by one thread only. Each thread draws from its own random
+    // stream, and the cache-wide policy state is updated under a lock. Not
+    // available for OPT. Call before the first access.
+    void   EnableSharedAccess();
+
+    // OPT needs the next use (next_use.h) of every access before the access
+    // is handed to the cache, and sees writeback hits as well. With bypass
+    // on, a missing line whose next use is further away than that of every
+    // line in its set is not filled.
+    void   SetNextUse( COUNTER nextUse ) { currNextUse = nextUse; }
+    void   SetOPTBypass( bool bypass ) { optBypass = bypass; }
+    bool   UpdatesOnWriteback() const { return replPolicy == CRC_REPL_OPT; }
+
+    // Replaces the SHiP predictor with one of the given configuration (see
+    // ship_predictor.h); lines in the cache forget their signatures. Call
+    // before the first access.
+    void   SetSHiPConfig( const SHIP_CONFIG &config );
+    SHIP_PREDICTOR * SHiPPredictor() { return ship; }
+
     void   UpdateReplacementState( UINT32 setIndex, INT32 updateWayID, const LINE_STATE *currLine, 
-                                   UINT32 tid, Addr_t PC, UINT32 accessType, bool cacheHit);
+                                   UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType, bool cacheHit);
+
+    // Policy-specialized versions of the two calls above. With the policy
+    // a template argument the policy selection folds away at compile time;
+    // GetVictimInSet/UpdateReplacementState dispatch to these at run time.
+    // Instantiated for every policy in CRC_REPL_FOR_EACH_POLICY.
+    template <UINT32 POL>
+    INT32  GetVictimInSetT( UINT32 tid, UINT32 setIndex, const LINE_STATE *vicSet,
+                            Addr_t PC, Addr_t paddr, UINT32 accessType );
+    template <UINT32 POL>
+    void   UpdateReplacementStateT( UINT32 setIndex, INT32 updateWayID, const LINE_STATE *currLine,
+                                    UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType, bool cacheHit );
+
+    // Prefetch the state of a set that the policy touches on an access, for
+    // batched lookups; PrefetchSet dispatches on the policy at run time
+    void   PrefetchSet( UINT32 setIndex ) const;
+    template <UINT32 POL>
+    void   PrefetchSetT( UINT32 setIndex ) const
+    {
+        if( CRC_ReplUsesLRUStack( POL ) )
+        {
+            CRC_PrefetchRange( lruAge + (size_t) setIndex * assoc, assoc, true );
+        }
+        else if( CRC_ReplUsesRRPV( POL ) )
+        {
+            CRC_PrefetchRange( rrpv + (size_t) setIndex * rrpvWords, rrpvWords * sizeof(BITVECTOR), true );
+        }
+        else if( POL == CRC_REPL_PLRU )
+        {
+            CRC_PrefetchRange( plruTree + setIndex, sizeof(BITVECTOR), true );
+        }
+        else if( POL == CRC_REPL_OPT )
+        {
+            CRC_PrefetchRange( optNextUse + (size_t) setIndex * assoc, assoc * sizeof(COUNTER), true );
+        }
+
+        // SHiP also keeps its signatures in the line state
+        if( POL == CRC_REPL_SHIPPC )
+        {
+            CRC_PrefetchRange( shipFlags + (size_t) setIndex * SHIP_LINE_FLAGS, SHIP_LINE_FLAGS * sizeof(BITVECTOR), true );
+            CRC_PrefetchRange( (char *) shipSigs + (size_t) setIndex * assoc * shipSigBytes, assoc * shipSigBytes, true );
+        }
+    }
 
     ostream&   PrintStats( ostream &out);
 
+    // Register the policy counters for snapshots (stats_registry.h)
+    void       RegisterStats( CRC_STATS_REGISTRY *registry );
+
+    // Zero the statistics, keeping the state the policy decides by
+    void       ResetStats();
+
+    // The state the policy uses, random streams and timer included
+    // (checkpoint.h). Restore expects the policy, threads and policy
+    // configuration that were saved. Not available for OPT, whose state
+    // refers to positions in one trace.
+    void       Save( CRC_CHECKPOINT_WRITER *ckpt ) const;
+    bool       Restore( CRC_CHECKPOINT_READER *ckpt );
+
   private:
     
     void   InitReplacementState();
-    INT32  Get_Random_Victim( UINT32 setIndex );
+
+    CACHE_REPLACEMENT_STATE( const CACHE_REPLACEMENT_STATE & );
+    CACHE_REPLACEMENT_STATE & operator=( const CACHE_REPLACEMENT_STATE & );
+
+    // Packed RRPV access
+    BITVECTOR RRPVLanes( UINT32 word ) const { return (word == rrpvWords - 1) ? rrpvLastLanes : CRC_RRPV_LANES; }
+
+    UINT32 GetRRPV( UINT32 setIndex, UINT32 way ) const
+    {
+        BITVECTOR word = rrpv[ setIndex * rrpvWords + way / CRC_RRPV_PER_WORD ];
+        return (UINT32) (word >> (CRC_RRPV_BITS * (way % CRC_RRPV_PER_WORD))) & CRC_RRPV_MAX;
+    }
+
+    void   SetRRPV( UINT32 setIndex, UINT32 way, UINT32 value )
+    {
+        BITVECTOR &word  = rrpv[ setIndex * rrpvWords + way / CRC_RRPV_PER_WORD ];
+        UINT32     shift = CRC_RRPV_BITS * (way % CRC_RRPV_PER_WORD);
+        word = (word & ~((BITVECTOR) CRC_RRPV_MAX << shift)) | ((BITVECTOR) value << shift);
+    }
+
+    CRC_RANDOM_STREAM & Stream( UINT32 tid ) { return streams[ shared ? tid : 0 ]; }
+
+    // True for the rare insertion of BIP and BRRIP, once per
+    // CRC_BIMODAL_PERIOD fills of the set on average
+    bool   BimodalDraw( UINT32 setIndex )
+    {
+        UINT32 fill = ++bimodalFills[ setIndex ];
+
+        if( bimodalThrottle ) return fill % CRC_BIMODAL_PERIOD == 0;
+
+        BITVECTOR set = (BITVECTOR) setIndex * setStride + setOffset;
+        BITVECTOR key = CRC_RANDOM::Mix( seed ^ ((set << 32) | fill) );
+
+        return (UINT32) (((key >> 32) * CRC_BIMODAL_PERIOD) >> 32) == 0;
+    }
+
+    // Lock to hold while updating cache-wide state, NULL if not shared
+    CRC_SPIN_LOCK * PolicyLock() { return shared ? &policyLock.lock : NULL; }
+
+    // A miss for set dueling; only leader misses touch the selectors, so
+    // only those take the lock
+    void   DuelingMiss( UINT32 setIndex )
+    {
+        if( shared && !duel->IsLeader( setIndex ) ) return;
+
+        CRC_SPIN_GUARD guard( PolicyLock() );
+        duel->Miss( setIndex );
+    }
+
+    // Move a way to the MRU / LRU end of the LRU stack
+    void   PromoteLRU( UINT32 setIndex, INT32 updateWayID );
+    void   DemoteLRU( UINT32 setIndex, INT32 updateWayID );
+    INT32  Get_Random_Victim( UINT32 setIndex, UINT32 tid );
 
     INT32  Get_LRU_Victim( UINT32 setIndex );
     void   UpdateLRU( UINT32 setIndex, INT32 updateWayID );
@@ -104,16 +383,45 @@ class CACHE_REPLACEMENT_STATE
     INT32  Get_SRRIP_Victim( UINT32 setIndex );
     void   UpdateSRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit );
 
-    void   UpdateBIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit );
+    void   UpdateBIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid );
 
  //   void   Get_BRRIP_Victim( UINT32 setIndex ); BRRIP, SHIP PC victim selection is same as SRRIP
-    void   UpdateBRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit );
-    void   UpdateDRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit );
+    void   UpdateBRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid );
+    void   UpdateDIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid );
+    void   UpdateDRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid );
+    void   UpdateTADRRIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid );
+    void   UpdateTADIP( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid );
+    void   InitDueling();
+    void   DuelingNames( string *names ) const;
 // for SHiP
-    void   UpdateSHIPPC( UINT32 setIndex, INT32 updateWayID, bool cacheHit, Addr_t PC) ;
-// plru
-	INT32  Get_PLRU_Victim( UINT32 setIndex );
-	void   UpdatePLRU( UINT32 setIndex, INT32 updateWayID, bool cacheHit );
+    void   UpdateSHIPPC( UINT32 setIndex, INT32 updateWayID, bool cacheHit, UINT32 tid, Addr_t PC, Addr_t paddr );
+    void   InitSHiPLines();
+    size_t SHiPLineBytes() const
+    {
+        return (size_t) numsets * (SHIP_LINE_FLAGS * sizeof(BITVECTOR) + assoc * shipSigBytes);
+    }
+
+    UINT32 GetSHiPSignature( size_t line ) const
+    {
+        return shipSigBytes == 2 ? ((const unsigned short *) shipSigs)[ line ] : ((const UINT32 *) shipSigs)[ line ];
+    }
+
+    void   SetSHiPSignature( size_t line, UINT32 signature )
+    {
+        if( shipSigBytes == 2 ) ((unsigned short *) shipSigs)[ line ] = (unsigned short) signature;
+        else                    ((UINT32 *) shipSigs)[ line ]         = signature;
+    }
+
+    void   InitPLRU();
+    INT32  Get_PLRU_Victim( UINT32 setIndex );
+    void   UpdatePLRU( UINT32 setIndex, INT32 updateWayID )
+    {
+        BITVECTOR &tree = plruTree[ setIndex ];
+        tree = (tree & ~plruPathMask[ updateWayID ]) | plruPathBits[ updateWayID ];
+    }
+
+    INT32  Get_OPT_Victim( UINT32 setIndex );
+    void   UpdateOPT( UINT32 setIndex, INT32 updateWayID );
 
 
 };
@@ -0,0 +1,344 @@
+#include "set_dueling.h"
+
+#include <iomanip>
+#include <sstream>
+#include <cstring>
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The constructor lays out the leader sets. PSEL starts just below its MSB,  //
+// so the followers begin with policy 0.                                      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+SET_DUELING::SET_DUELING( UINT32 _sets, UINT32 _policies, UINT32 _leaders, UINT32 _pselBits,
+                          UINT32 _groups )
+{
+    numsets     = _sets;
+    numPolicies = _policies;
+    numGroups   = _groups;
+    leaders     = _leaders;
+    pselMax     = (1 << _pselBits) - 1;
+
+    assert( numsets > 0 );
+    assert( (leaders & (leaders - 1)) == 0 && leaders > 0 );
+    assert( numPolicies >= 2 && numPolicies <= CRC_DUEL_MAX_POLICIES );
+    assert( numGroups >= 1 && numGroups <= CRC_DUEL_MAX_GROUPS );
+    assert( _pselBits >= 2 && _pselBits <= 31 );
+
+    // Every constituency needs room for the leaders of all policy pairs of
+    // all groups
+    UINT32 slots = numGroups * numPolicies;
+    UINT32 pairs = (slots + 1) / 2;
+
+    assert( slots < CRC_DUEL_FOLLOWER );
+    while( leaders > 1 && (COUNTER) pairs * leaders * leaders > numsets ) leaders /= 2;
+
+    UINT32 constituency = numsets / leaders;
+
+    leaderOf = new unsigned char[ numsets ];
+    for(UINT32 s=0; s<numsets; s++) leaderOf[s] = CRC_DUEL_FOLLOWER;
+
+    for(UINT32 k=0; k<leaders; k++)
+    {
+        for(UINT32 q=0; q<slots; q++)
+        {
+            UINT32 offset = (q / 2) * leaders + k;
+
+            if( offset >= constituency ) continue;      // cache too small
+            if( q & 1 ) offset = constituency - 1 - offset;
+
+            UINT32 set = k * constituency + offset;
+            if( leaderOf[ set ] == CRC_DUEL_FOLLOWER ) leaderOf[ set ] = q;
+        }
+    }
+
+    selectors = new DUEL_SELECTOR[ numGroups ];
+
+    for(UINT32 g=0; g<numGroups; g++)
+    {
+        DUEL_SELECTOR &sel = selectors[g];
+
+        sel.psel   = pselMax / 2;
+        sel.winner.store( 0, memory_order_relaxed );
+
+        for(UINT32 p=0; p<CRC_DUEL_MAX_POLICIES; p++)
+        {
+            sel.missCount[p]    = 0;
+            sel.leaderMisses[p] = 0;
+            sel.winnerTime[p]   = 0;
+        }
+
+        sel.switches       = 0;
+        sel.pselLow        = sel.psel;
+        sel.pselHigh       = sel.psel;
+        sel.sampleInterval = 1;
+        sel.events         = 0;
+    }
+}
+
+SET_DUELING::~SET_DUELING()
+{
+    delete [] leaderOf;
+    delete [] selectors;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function counts a miss in a leader set of policy and re-evaluates the  //
+// winner of the selector                                                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void SET_DUELING::Train( DUEL_SELECTOR &sel, UINT32 policy )
+{
+    UINT32 previous = sel.winner.load( memory_order_relaxed );
+    UINT32 winner   = 0;
+
+    if( numPolicies == 2 )
+    {
+        if( policy == 0 ) { if( sel.psel < pselMax ) sel.psel++; }
+        else              { if( sel.psel > 0 ) sel.psel--; }
+
+        winner = (sel.psel > pselMax / 2) ? 1 : 0;
+
+        if( sel.psel < sel.pselLow )  sel.pselLow  = sel.psel;
+        if( sel.psel > sel.pselHigh ) sel.pselHigh = sel.psel;
+    }
+    else
+    {
+        if( ++sel.missCount[ policy ] == pselMax )
+        {
+            for(UINT32 p=0; p<numPolicies; p++) sel.missCount[p] /= 2;
+        }
+
+        for(UINT32 p=1; p<numPolicies; p++)
+        {
+            if( sel.missCount[p] < sel.missCount[ winner ] ) winner = p;
+        }
+    }
+
+    sel.winner.store( winner, memory_order_relaxed );
+
+    sel.leaderMisses[ policy ]++;
+    sel.winnerTime[ previous ]++;
+    if( winner != previous ) sel.switches++;
+
+    if( ++sel.events % sel.sampleInterval == 0 ) Sample( sel );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The trajectory keeps at most CRC_DUEL_TRAJECTORY samples spread over the   //
+// whole run: when it fills up every other sample is dropped and the          //
+// sampling interval doubles                                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void SET_DUELING::Sample( DUEL_SELECTOR &sel )
+{
+    sel.trajectory.push_back( numPolicies == 2 ? sel.psel : sel.winner.load( memory_order_relaxed ) );
+
+    if( sel.trajectory.size() == CRC_DUEL_TRAJECTORY )
+    {
+        for(UINT32 i=0; i<CRC_DUEL_TRAJECTORY / 2; i++) sel.trajectory[i] = sel.trajectory[ 2 * i + 1 ];
+        sel.trajectory.resize( CRC_DUEL_TRAJECTORY / 2 );
+        sel.sampleInterval *= 2;
+    }
+}
+
+ostream & SET_DUELING::PrintStats( ostream &out, const string *names, const char *groupName )
+{
+    out<<"Set Dueling: "<<numPolicies<<" policies, "<<leaders<<" leader sets each";
+    if( numGroups > 1 ) out<<" for each of "<<numGroups<<" "<<groupName<<"s";
+    out<<endl;
+
+    for(UINT32 g=0; g<numGroups; g++)
+    {
+        string prefix;
+
+        if( numGroups > 1 )
+        {
+            ostringstream label;
+            label<<groupName<<" "<<g<<" ";
+            prefix = label.str();
+        }
+
+        PrintSelector( out, selectors[g], names, prefix );
+    }
+
+    return out;
+}
+
+ostream & SET_DUELING::PrintSelector( ostream &out, const DUEL_SELECTOR &sel, const string *names,
+                                      const string &prefix )
+{
+    ios::fmtflags flags     = out.flags();
+    streamsize    precision = out.precision();
+
+    for(UINT32 p=0; p<numPolicies; p++)
+    {
+        out<<"\t"<<prefix<<left<<setw(10)<<names[p]<<right<<" Leader Misses: "<<setw(10)<<sel.leaderMisses[p]
+           <<"  Winning: "<<fixed<<setprecision(2)
+           <<(sel.events ? 100.0 * sel.winnerTime[p] / sel.events : 0.0)<<"%"<<endl;
+    }
+
+    out<<prefix<<"Winner: "<<names[ sel.winner.load( memory_order_relaxed ) ]<<" ("<<sel.switches<<" switches)"<<endl;
+
+    if( numPolicies == 2 )
+    {
+        out<<prefix<<"PSEL: "<<sel.psel<<" (range "<<sel.pselLow<<"-"<<sel.pselHigh<<" of 0-"<<pselMax<<")"<<endl;
+    }
+
+    out<<prefix<<(numPolicies == 2 ? "PSEL" : "Winner")<<" Trajectory (every "<<sel.sampleInterval
+       <<" leader misses):";
+    for(UINT32 i=0; i<sel.trajectory.size(); i++) out<<" "<<sel.trajectory[i];
+    out<<endl;
+
+    out.flags( flags );
+    out.precision( precision );
+
+    return out;
+}
+
+void SET_DUELING::ResetStats()
+{
+    for(UINT32 g=0; g<numGroups; g++)
+    {
+        DUEL_SELECTOR &sel = selectors[g];
+
+        for(UINT32 p=0; p<CRC_DUEL_MAX_POLICIES; p++)
+        {
+            sel.leaderMisses[p] = 0;
+            sel.winnerTime[p]   = 0;
+        }
+
+        sel.switches       = 0;
+        sel.pselLow        = sel.psel;
+        sel.pselHigh       = sel.psel;
+        sel.sampleInterval = 1;
+        sel.events         = 0;
+        sel.trajectory.clear();
+    }
+}
+
+void SET_DUELING::RegisterStats( CRC_STATS_REGISTRY *registry, const string *names, const char *groupName )
+{
+    for(UINT32 g=0; g<numGroups; g++)
+    {
+        DUEL_SELECTOR *sel = &selectors[g];
+        ostringstream  label;
+
+        label<<"duel.";
+        if( numGroups > 1 ) label<<groupName<<g<<".";
+
+        string prefix = label.str();
+
+        for(UINT32 p=0; p<numPolicies; p++)
+        {
+            registry->Register( prefix + names[p] + ".misses", &sel->leaderMisses[p] );
+        }
+        registry->Register( prefix + "switches", &sel->switches );
+        registry->Register( prefix + "winner", [sel] { return (COUNTER) sel->winner.load( memory_order_relaxed ); } );
+
+        if( numPolicies == 2 ) registry->Register( prefix + "psel", [sel] { return (COUNTER) sel->psel; } );
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Checkpoints. DUEL_SELECTOR holds an atomic and a vector, so every selector //
+// is flattened into a DUEL_CHECKPOINT; the leader layout follows from the    //
+// configuration and is not saved.                                            //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+typedef struct
+{
+    UINT32      psel;
+    UINT32      winner;
+    UINT32      missCount[ CRC_DUEL_MAX_POLICIES ];
+    COUNTER     leaderMisses[ CRC_DUEL_MAX_POLICIES ];
+    COUNTER     winnerTime[ CRC_DUEL_MAX_POLICIES ];
+    COUNTER     switches;
+    UINT32      pselLow, pselHigh;
+    COUNTER     sampleInterval;
+    COUNTER     events;
+    UINT32      samples;
+    UINT32      trajectory[ CRC_DUEL_TRAJECTORY ];
+} DUEL_CHECKPOINT;
+
+void SET_DUELING::Save( CRC_CHECKPOINT_WRITER *ckpt ) const
+{
+    UINT32 config[4] = { numPolicies, numGroups, leaders, pselMax };
+
+    ckpt->Section( CKPT_DUEL_CONFIG, config, sizeof(config) );
+    ckpt->BeginSection( CKPT_DUEL_SELECTORS, numGroups * sizeof(DUEL_CHECKPOINT) );
+
+    for(UINT32 g=0; g<numGroups; g++)
+    {
+        const DUEL_SELECTOR &sel = selectors[g];
+        DUEL_CHECKPOINT      saved;
+
+        memset( &saved, 0, sizeof(saved) );
+        saved.psel = sel.psel;
+        saved.winner = sel.winner.load( memory_order_relaxed );
+        for(UINT32 p=0; p<CRC_DUEL_MAX_POLICIES; p++)
+        {
+            saved.missCount[p]    = sel.missCount[p];
+            saved.leaderMisses[p] = sel.leaderMisses[p];
+            saved.winnerTime[p]   = sel.winnerTime[p];
+        }
+        saved.switches       = sel.switches;
+        saved.pselLow        = sel.pselLow;
+        saved.pselHigh       = sel.pselHigh;
+        saved.sampleInterval = sel.sampleInterval;
+        saved.events         = sel.events;
+        saved.samples        = sel.trajectory.size();
+        for(UINT32 i=0; i<saved.samples; i++) saved.trajectory[i] = sel.trajectory[i];
+
+        ckpt->Append( &saved, sizeof(saved) );
+    }
+}
+
+bool SET_DUELING::Restore( CRC_CHECKPOINT_READER *ckpt )
+{
+    UINT32         config[4] = { numPolicies, numGroups, leaders, pselMax };
+    const UINT32  *saved     = (const UINT32 *) ckpt->Section( CKPT_DUEL_CONFIG, sizeof(config) );
+
+    if( saved == NULL ) return false;
+    if( memcmp( saved, config, sizeof(config) ) != 0 )
+    {
+        cerr<<"checkpoint: the set dueling configuration differs from the saved one"<<endl;
+        return false;
+    }
+
+    const DUEL_CHECKPOINT *groups = (const DUEL_CHECKPOINT *) ckpt->Section( CKPT_DUEL_SELECTORS,
+                                                                             numGroups * sizeof(DUEL_CHECKPOINT) );
+    if( groups == NULL ) return false;
+
+    for(UINT32 g=0; g<numGroups; g++)
+    {
+        DUEL_SELECTOR         &sel = selectors[g];
+        const DUEL_CHECKPOINT &in  = groups[g];
+
+        if( in.samples > CRC_DUEL_TRAJECTORY || in.winner >= numPolicies )
+        {
+            cerr<<"checkpoint: corrupt set dueling selector"<<endl;
+            return false;
+        }
+
+        sel.psel = in.psel;
+        sel.winner.store( in.winner, memory_order_relaxed );
+        for(UINT32 p=0; p<CRC_DUEL_MAX_POLICIES; p++)
+        {
+            sel.missCount[p]    = in.missCount[p];
+            sel.leaderMisses[p] = in.leaderMisses[p];
+            sel.winnerTime[p]   = in.winnerTime[p];
+        }
+        sel.switches       = in.switches;
+        sel.pselLow        = in.pselLow;
+        sel.pselHigh       = in.pselHigh;
+        sel.sampleInterval = in.sampleInterval;
+        sel.events         = in.events;
+        sel.trajectory.assign( in.trajectory, in.trajectory + in.samples );
+    }
+
+    return true;
+}
@@ -0,0 +1,151 @@
+#ifndef CRC_SET_DUELING_H
+#define CRC_SET_DUELING_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Set dueling (Qureshi et al., ISCA'07) between numPolicies policies. A few  //
+// leader sets always run one of the policies and the misses in them train    //
+// a selector; every other (follower) set runs the policy that currently      //
+// misses least.                                                              //
+//                                                                            //
+// Leader sets follow the constituency scheme: the sets are split into        //
+// leaders constituencies of C sets, and in constituency k the leader of      //
+// policy 2j sits at offset j*leaders+k, the leader of policy 2j+1 at the     //
+// complement C-1-(j*leaders+k). With 1024 sets and 32 leaders this gives     //
+// the classic DRRIP/DIP layout: set index bits 4-0 equal to bits 9-5, or     //
+// to their complement. The leader count is reduced for caches too small to   //
+// fit every policy's leaders. Any set count works: when it is not a          //
+// multiple of leaders, the sets past the last whole constituency follow.     //
+//                                                                            //
+// Two policies share one pselBits-wide PSEL counter, counting up on misses   //
+// in policy 0's leaders and down on misses in policy 1's; the followers run  //
+// policy 1 once its MSB is set. With more policies every policy has its own  //
+// saturating miss counter, all of them are halved when one saturates, and    //
+// the followers run the policy with the fewest misses.                       //
+//                                                                            //
+// With several groups (thread-aware dueling, TADIP-F/TA-DRRIP) every group   //
+// has its own leader sets and selector. In the leader sets of group g only   //
+// group g's accesses use the leader's policy; the other groups use their     //
+// own winners there as everywhere else. All misses in g's leader sets train  //
+// g's selector, so each group learns the policy that is best for the cache   //
+// as a whole given what the others do.                                       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <vector>
+#include <atomic>
+#include "utils.h"
+#include "stats_registry.h"
+#include "checkpoint.h"
+
+#define CRC_DUEL_MAX_POLICIES   8
+#define CRC_DUEL_MAX_GROUPS     32
+#define CRC_DUEL_FOLLOWER       0xff
+#define CRC_DUEL_TRAJECTORY     64      // PSEL samples kept for the statistics
+
+// Selector of one group
+typedef struct
+{
+    UINT32          psel;                                   // two policies
+    UINT32          missCount[ CRC_DUEL_MAX_POLICIES ];     // more policies
+    atomic<UINT32>  winner;         // read by followers without a lock
+
+    // statistics
+    COUNTER         leaderMisses[ CRC_DUEL_MAX_POLICIES ];
+    COUNTER         winnerTime[ CRC_DUEL_MAX_POLICIES ];    // leader misses spent as winner
+    COUNTER         switches;
+    UINT32          pselLow, pselHigh;
+    vector<UINT32>  trajectory;     // selector sampled every sampleInterval leader misses
+    COUNTER         sampleInterval;
+    COUNTER         events;
+} DUEL_SELECTOR;
+
+class SET_DUELING
+{
+  private:
+
+    UINT32          numsets;
+    UINT32          numPolicies;
+    UINT32          numGroups;
+    UINT32          leaders;        // leader sets per policy and group
+    UINT32          pselMax;
+    unsigned char  *leaderOf;       // per set: group * numPolicies + policy it
+                                    // leads, or CRC_DUEL_FOLLOWER
+    DUEL_SELECTOR  *selectors;      // one per group
+
+  public:
+
+    SET_DUELING( UINT32 _sets, UINT32 _policies=2, UINT32 _leaders=32, UINT32 _pselBits=10,
+                 UINT32 _groups=1 );
+    ~SET_DUELING();
+
+    UINT32  NumPolicies() const { return numPolicies; }
+    UINT32  NumGroups() const { return numGroups; }
+    UINT32  NumLeaders() const { return leaders; }
+
+    // Policy a leader set of the group is dedicated to, or -1
+    INT32   LeaderOf( UINT32 setIndex, UINT32 group=0 ) const
+    {
+        UINT32 slot = leaderOf[ setIndex ];
+        return (slot == CRC_DUEL_FOLLOWER || slot / numPolicies != group) ? -1 : (INT32) (slot % numPolicies);
+    }
+
+    // Leader set of any group?
+    bool    IsLeader( UINT32 setIndex ) const { return leaderOf[ setIndex ] != CRC_DUEL_FOLLOWER; }
+
+    // Policy the group runs in the set: the leader's own policy in the
+    // group's leader sets, the group's winner everywhere else
+    UINT32  Policy( UINT32 setIndex, UINT32 group=0 ) const
+    {
+        INT32 leader = LeaderOf( setIndex, group );
+        return leader < 0 ? Winner( group ) : (UINT32) leader;
+    }
+
+    UINT32  Winner( UINT32 group=0 ) const { return selectors[ group ].winner.load( memory_order_relaxed ); }
+
+    // A miss in the set; trains the selector of the group the set leads for.
+    // Concurrent callers must serialize this; Policy() and Winner() may run
+    // alongside it.
+    void    Miss( UINT32 setIndex )
+    {
+        UINT32 slot = leaderOf[ setIndex ];
+        if( slot != CRC_DUEL_FOLLOWER ) Train( selectors[ slot / numPolicies ], slot % numPolicies );
+    }
+
+    // Selector value: PSEL for two policies, the winner otherwise
+    UINT32  Selector( UINT32 group=0 ) const
+    {
+        return numPolicies == 2 ? selectors[ group ].psel : Winner( group );
+    }
+
+    // names[p] labels policy p; groupName labels the groups if there are several
+    ostream &   PrintStats( ostream &out, const string *names, const char *groupName = "Group" );
+
+    // Leader misses per policy, switches and selector of every group, named
+    // duel.[<groupName><g>.]<policy>.misses and so on
+    void        RegisterStats( CRC_STATS_REGISTRY *registry, const string *names,
+                               const char *groupName = "group" );
+
+    // Zero the statistics and restart the PSEL trajectory; the selectors
+    // keep their values
+    void        ResetStats();
+
+    // Selectors and their statistics (checkpoint.h); Restore fails unless
+    // the policies, groups, leaders and PSEL width match the saved ones
+    void        Save( CRC_CHECKPOINT_WRITER *ckpt ) const;
+    bool        Restore( CRC_CHECKPOINT_READER *ckpt );
+
+  private:
+
+    void    Train( DUEL_SELECTOR &sel, UINT32 policy );
+    void    Sample( DUEL_SELECTOR &sel );
+    ostream &   PrintSelector( ostream &out, const DUEL_SELECTOR &sel, const string *names,
+                               const string &prefix );
+
+    SET_DUELING( const SET_DUELING & );
+    SET_DUELING & operator=( const SET_DUELING & );
+};
+
+#endif
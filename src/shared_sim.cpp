@@ -0,0 +1,117 @@
+#include "shared_sim.h"
+
+CRC_SHARED_CACHE::CRC_SHARED_CACHE( UINT32 _cacheSize, UINT32 _assoc, UINT32 _tpc, UINT32 _producers,
+                                    UINT32 _linesize, UINT32 _pol )
+{
+    numProducers = (_producers < _tpc) ? _producers : _tpc;
+    ordered      = false;
+    turn         = 0;
+
+    assert( numProducers > 0 );
+
+    cache = new CRC_CACHE( _cacheSize, _assoc, _tpc, _linesize, _pol );
+    cache->EnableSharedAccess();
+
+    issued.assign( numProducers, 0 );
+}
+
+CRC_SHARED_CACHE::~CRC_SHARED_CACHE()
+{
+    delete cache;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function opens one trace reader per producer, so that no producer      //
+// waits for another to hand it records, and runs the producers to the end    //
+// of the trace                                                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool CRC_SHARED_CACHE::Replay( const char *path, bool _ordered )
+{
+    vector<TRACE_SOURCE *> traces;
+    vector<thread>         producers;
+
+    for(UINT32 p=0; p<numProducers; p++)
+    {
+        TRACE_SOURCE *trace = OpenTraceSource( path );
+
+        if( trace == NULL )
+        {
+            for(UINT32 q=0; q<traces.size(); q++) delete traces[q];
+            return false;
+        }
+        traces.push_back( trace );
+    }
+
+    ordered = _ordered;
+    turn.store( 0, memory_order_relaxed );
+
+    for(UINT32 p=0; p<numProducers; p++)
+    {
+        producers.push_back( thread( &CRC_SHARED_CACHE::ProducerLoop, this, p, traces[p] ) );
+    }
+
+    bool ok = true;
+
+    for(UINT32 p=0; p<numProducers; p++)
+    {
+        producers[p].join();
+        ok = ok && !traces[p]->Failed();
+        delete traces[p];
+    }
+
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Body of a producer thread: walk the whole trace and issue the accesses of  //
+// this producer's threads. In ordered mode each access waits for its trace   //
+// position to come up and passes the turn on to the next one; the release    //
+// of the turn orders everything the access did before the next access.       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_SHARED_CACHE::ProducerLoop( UINT32 producer, TRACE_SOURCE *trace )
+{
+    const TRACE_RECORD *rec;
+    UINT32              n;
+    COUNTER             position = 0;
+    COUNTER             count    = 0;
+
+    while( (n = trace->NextBatch( &rec )) != 0 )
+    {
+        for(UINT32 i=0; i<n; i++)
+        {
+            if( rec[i].tid % numProducers != producer ) continue;
+
+            if( ordered ) WaitTurn( position + i );
+
+            cache->LookupAndFillCache( rec[i].tid, rec[i].PC, rec[i].paddr, rec[i].accessType );
+            count++;
+
+            if( ordered ) turn.store( position + i + 1, memory_order_release );
+        }
+        position += n;
+    }
+
+    issued[ producer ] = count;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The turn usually comes up within a few accesses of the other producers;    //
+// past CRC_TURN_SPINS the waiter yields on every check, so that the owner    //
+// of the turn gets to run when there are more producers than cores           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_SHARED_CACHE::WaitTurn( COUNTER position )
+{
+    UINT32 spins = 0;
+
+    while( turn.load( memory_order_acquire ) != position )
+    {
+        if( ++spins > CRC_TURN_SPINS ) this_thread::yield();
+        else                           CRC_CpuRelax();
+    }
+}
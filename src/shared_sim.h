@@ -0,0 +1,78 @@
+#ifndef CRC_SHARED_SIM_H
+#define CRC_SHARED_SIM_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Concurrent replay of a multi-core trace into one shared LLC. Every core    //
+// (trace thread) is driven by a producer thread that reads the trace on its  //
+// own and issues its core's accesses, in program order, straight into a      //
+// single CRC_CACHE in shared mode (CRC_CACHE::EnableSharedAccess). With      //
+// fewer producers than threads, producer p issues the accesses of every      //
+// thread t with t % producers == p.                                          //
+//                                                                            //
+// Unlike the set-partitioned CRC_PARALLEL_CACHE there is no dispatcher: the  //
+// producers only meet in the sets they both touch and in the cache-wide      //
+// policy state. Per-set policies (LRU, SRRIP, PLRU, ...) therefore scale     //
+// with the producers; the set dueling selectors are locked on leader misses  //
+// only, the SHiP table on every update.                                      //
+//                                                                            //
+// Free-running producers interleave the cores the way the host happens to    //
+// schedule them, so results vary slightly from run to run. In ordered mode   //
+// the accesses are issued in trace order instead, the trace position acting  //
+// as a global timestamp: a producer waits until all earlier accesses have    //
+// been issued. This serializes the replay but makes it deterministic, and    //
+// identical to a serial run except for the random streams, which are per     //
+// thread in shared mode.                                                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "crc_cache.h"
+#include "trace.h"
+
+#define CRC_TURN_SPINS  64      // ordered mode: spins before yielding
+
+class CRC_SHARED_CACHE
+{
+  private:
+
+    UINT32                  numProducers;
+    CRC_CACHE              *cache;
+    bool                    ordered;
+    vector<COUNTER>         issued;     // accesses issued by each producer
+
+    // Ordered mode: trace position of the next access to issue
+    alignas(CRC_CACHE_LINE) atomic<COUNTER>  turn;
+
+  public:
+
+    // The number of producers is capped at the number of threads
+    CRC_SHARED_CACHE( UINT32 _cacheSize, UINT32 _assoc, UINT32 _tpc, UINT32 _producers,
+                      UINT32 _linesize=64, UINT32 _pol=CRC_REPL_LRU );
+    ~CRC_SHARED_CACHE();
+
+    // Configure the policy through the cache before replaying
+    CRC_CACHE * Cache() { return cache; }
+
+    // Replays the whole trace at path with every producer reading its own
+    // copy; false (with an explanation on cerr) if it cannot be opened
+    bool   Replay( const char *path, bool _ordered );
+
+    UINT32 NumProducers() const { return numProducers; }
+    COUNTER Issued( UINT32 producer ) const { return issued[ producer ]; }
+
+    ostream &   PrintStats( ostream &out ) { return cache->PrintStats( out ); }
+
+  private:
+
+    void   ProducerLoop( UINT32 producer, TRACE_SOURCE *trace );
+    void   WaitTurn( COUNTER position );
+
+    CRC_SHARED_CACHE( const CRC_SHARED_CACHE & );
+    CRC_SHARED_CACHE & operator=( const CRC_SHARED_CACHE & );
+};
+
+#endif
@@ -0,0 +1,214 @@
+#include "ship_predictor.h"
+
+#include <iomanip>
+#include <cstring>
+
+string ship_sig_names[ SHIP_SIG_MAX ] =
+{
+    "pc",
+    "mem",
+    "iseq"
+};
+
+SHIP_CONFIG DefaultSHiPConfig()
+{
+    SHIP_CONFIG config;
+
+    config.source        = SHIP_SIG_PC;
+    config.indexBits     = 14;
+    config.counterBits   = 3;
+    config.tables        = 1;
+    config.regionShift   = 14;
+    config.historyLength = 4;
+
+    return config;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// All counters start at zero (distant insertion) until the signature has     //
+// been seen to hit                                                           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+SHIP_PREDICTOR::SHIP_PREDICTOR( const SHIP_CONFIG &_config )
+{
+    config = _config;
+
+    assert( config.source < SHIP_SIG_MAX );
+    assert( config.indexBits >= 1 && config.indexBits <= 24 );
+    assert( config.counterBits >= 1 && config.counterBits <= 4 );
+    assert( config.tables >= 1 && config.tables <= CRC_SHIP_MAX_THREADS );
+    assert( config.historyLength >= 1 && config.historyLength <= 8 );
+
+    entries    = 1 << config.indexBits;
+    counterMax = (1 << config.counterBits) - 1;
+    laneShift  = (config.counterBits == 1) ? 0 : (config.counterBits == 2) ? 1 : 2;
+    wordShift  = 6 - laneShift;
+
+    UINT32 total = config.tables * entries;
+    counterWords = (total + (1 << wordShift) - 1) >> wordShift;
+
+    counters = new BITVECTOR[ counterWords ];
+    owner    = new unsigned short[ total ];
+    for(UINT32 w=0; w<counterWords; w++) counters[w] = 0;
+    for(UINT32 e=0; e<total; e++) owner[e] = 0;
+
+    historyMask = (config.historyLength == 8) ? ~0ULL : (1ULL << (8 * config.historyLength)) - 1;
+    for(UINT32 t=0; t<CRC_SHIP_MAX_THREADS; t++) history[t] = 0;
+
+    fills        = 0;
+    distantFills = 0;
+    usedEntries  = 0;
+    aliasedFills = 0;
+    for(UINT32 p=0; p<2; p++) evictions[p][0] = evictions[p][1] = 0;
+}
+
+SHIP_PREDICTOR::~SHIP_PREDICTOR()
+{
+    delete [] counters;
+    delete [] owner;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function hashes the signature source and folds the hash into the       //
+// table of the thread. The high hash bits, which do not take part in the     //
+// index, serve as the aliasing tag.                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+UINT32 SHIP_PREDICTOR::Signature( UINT32 tid, Addr_t PC, Addr_t paddr )
+{
+    assert( tid < CRC_SHIP_MAX_THREADS );
+
+    BITVECTOR key;
+
+    switch( config.source )
+    {
+        case SHIP_SIG_PC:   key = PC; break;
+        case SHIP_SIG_MEM:  key = paddr >> config.regionShift; break;
+        default:            Advance( tid, PC ); key = history[ tid ]; break;
+    }
+
+    BITVECTOR hash  = Hash( key );
+    UINT32    table = (config.tables > 1) ? tid : 0;
+    UINT32    entry = table * entries + (UINT32) (hash & (entries - 1));
+    UINT32    tag   = (UINT32) (hash >> 48) | 1;
+
+    assert( table < config.tables );
+
+    if( owner[ entry ] != tag )
+    {
+        if( owner[ entry ] == 0 ) usedEntries++;
+        else                      aliasedFills++;
+        owner[ entry ] = tag;
+    }
+
+    return entry;
+}
+
+ostream & SHIP_PREDICTOR::PrintStats( ostream &out )
+{
+    COUNTER evicted = evictions[0][0] + evictions[0][1] + evictions[1][0] + evictions[1][1];
+    COUNTER correct = evictions[0][1] + evictions[1][0];
+
+    ios::fmtflags flags     = out.flags();
+    streamsize    precision = out.precision();
+
+    out<<"SHiP Signature:              "<<ship_sig_names[ config.source ]<<", "<<config.tables<<" x "
+       <<entries<<" entries of "<<config.counterBits<<" bits ("<<StorageBits() / 8<<" bytes)"<<endl;
+    out<<"SHiP Fills:                  "<<fills<<" ("<<distantFills<<" predicted distant)"<<endl;
+    out<<"SHiP Entries Used:           "<<usedEntries<<endl;
+    out<<"SHiP Aliased Fills:          "<<aliasedFills<<" ("<<fixed<<setprecision(2)
+       <<(fills ? 100.0 * aliasedFills / fills : 0.0)<<"%)"<<endl;
+    out<<"SHiP Evictions:              "<<evicted<<endl;
+    out<<"SHiP Dead Predicted Reused:  "<<evictions[1][1]<<endl;
+    out<<"SHiP Live Predicted Unused:  "<<evictions[0][0]<<endl;
+    out<<"SHiP Prediction Accuracy:    "<<(evicted ? 100.0 * correct / evicted : 0.0)<<"%"<<endl;
+    out.flags( flags );
+    out.precision( precision );
+
+    return out;
+}
+
+void SHIP_PREDICTOR::ResetStats()
+{
+    fills        = 0;
+    distantFills = 0;
+    aliasedFills = 0;
+    for(UINT32 p=0; p<2; p++) evictions[p][0] = evictions[p][1] = 0;
+}
+
+void SHIP_PREDICTOR::RegisterStats( CRC_STATS_REGISTRY *registry )
+{
+    registry->Register( "ship.fills",                 &fills );
+    registry->Register( "ship.distant_fills",         &distantFills );
+    registry->Register( "ship.used_entries",          &usedEntries );
+    registry->Register( "ship.aliased_fills",         &aliasedFills );
+    registry->Register( "ship.dead_predicted_reused", &evictions[1][1] );
+    registry->Register( "ship.live_predicted_unused", &evictions[0][0] );
+    registry->Register( "ship.evictions",
+                        [this] { return evictions[0][0] + evictions[0][1] + evictions[1][0] + evictions[1][1]; } );
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Checkpoints: the configuration first, so that a predictor of another       //
+// configuration is rejected before anything is copied                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void SHIP_PREDICTOR::Save( CRC_CHECKPOINT_WRITER *ckpt ) const
+{
+    COUNTER state[ CRC_SHIP_MAX_THREADS + 8 ];
+
+    for(UINT32 t=0; t<CRC_SHIP_MAX_THREADS; t++) state[t] = history[t];
+
+    COUNTER *stats = state + CRC_SHIP_MAX_THREADS;
+    stats[0] = fills;
+    stats[1] = distantFills;
+    stats[2] = usedEntries;
+    stats[3] = aliasedFills;
+    stats[4] = evictions[0][0];
+    stats[5] = evictions[0][1];
+    stats[6] = evictions[1][0];
+    stats[7] = evictions[1][1];
+
+    ckpt->Section( CKPT_SHIP_CONFIG, &config, sizeof(config) );
+    ckpt->Section( CKPT_SHIP_COUNTERS, counters, counterWords * sizeof(BITVECTOR) );
+    ckpt->Section( CKPT_SHIP_OWNERS, owner, (size_t) config.tables * entries * sizeof(unsigned short) );
+    ckpt->Section( CKPT_SHIP_STATE, state, sizeof(state) );
+}
+
+bool SHIP_PREDICTOR::Restore( CRC_CHECKPOINT_READER *ckpt )
+{
+    const SHIP_CONFIG *saved = (const SHIP_CONFIG *) ckpt->Section( CKPT_SHIP_CONFIG, sizeof(config) );
+
+    if( saved == NULL ) return false;
+    if( memcmp( saved, &config, sizeof(config) ) != 0 )
+    {
+        cerr<<"checkpoint: the SHiP configuration differs from the saved one"<<endl;
+        return false;
+    }
+
+    COUNTER state[ CRC_SHIP_MAX_THREADS + 8 ];
+
+    if( !ckpt->Read( CKPT_SHIP_COUNTERS, counters, counterWords * sizeof(BITVECTOR) )
+        || !ckpt->Read( CKPT_SHIP_OWNERS, owner, (size_t) config.tables * entries * sizeof(unsigned short) )
+        || !ckpt->Read( CKPT_SHIP_STATE, state, sizeof(state) ) )
+    {
+        return false;
+    }
+
+    for(UINT32 t=0; t<CRC_SHIP_MAX_THREADS; t++) history[t] = state[t];
+
+    const COUNTER *stats = state + CRC_SHIP_MAX_THREADS;
+    fills           = stats[0];
+    distantFills    = stats[1];
+    usedEntries     = stats[2];
+    aliasedFills    = stats[3];
+    evictions[0][0] = stats[4];
+    evictions[0][1] = stats[5];
+    evictions[1][0] = stats[6];
+    evictions[1][1] = stats[7];
+
+    return true;
+}
@@ -0,0 +1,181 @@
+#ifndef CRC_SHIP_PREDICTOR_H
+#define CRC_SHIP_PREDICTOR_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Signature history counter table (SHCT) of the SHiP replacement policy.     //
+// Every fill is tagged with a signature; a line that is hit trains its       //
+// signature's counter up, a line evicted without a hit trains it down, and   //
+// fills whose counter is zero are inserted with a distant RRPV.              //
+//                                                                            //
+// The signature is a hash of one of                                          //
+//                                                                            //
+//   pc      the PC of the access (SHiP-PC)                                   //
+//   mem     the memory region of the access, regionShift bits (SHiP-Mem)     //
+//   iseq    the PCs of the last historyLength accesses of the thread; the    //
+//           trace has no decode stream, so the instruction sequence of       //
+//           SHiP-ISeq is approximated by the thread's access path            //
+//                                                                            //
+// Counters are counterBits wide and packed into BITVECTORs, rounded up to    //
+// 1, 2 or 4 bit lanes. With one table per thread the threads do not train    //
+// each other's counters.                                                     //
+//                                                                            //
+// For aliasing statistics every entry remembers a 16-bit tag of the last     //
+// signature that mapped to it. These tags are simulation-only state and are  //
+// not counted in the predictor storage.                                      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include "utils.h"
+#include "stats_registry.h"
+#include "checkpoint.h"
+
+#define CRC_SHIP_MAX_THREADS  32      // sharing_dir has one bit per thread
+
+// Signature sources
+typedef enum
+{
+    SHIP_SIG_PC    = 0,
+    SHIP_SIG_MEM   = 1,
+    SHIP_SIG_ISEQ  = 2,
+    SHIP_SIG_MAX   = 3
+} ShipSignature;
+
+extern string ship_sig_names[ SHIP_SIG_MAX ];
+
+typedef struct
+{
+    UINT32  source;         // ShipSignature
+    UINT32  indexBits;      // log2 of the entries per table
+    UINT32  counterBits;    // saturating counter width, 1 to 4
+    UINT32  tables;         // 1 shared table, or one per thread
+    UINT32  regionShift;    // SHIP_SIG_MEM: log2 of the region size
+    UINT32  historyLength;  // SHIP_SIG_ISEQ: accesses in the history, 1 to 8
+} SHIP_CONFIG;
+
+// 16K entries of 3-bit counters indexed by a hash of the PC, shared by all
+// threads
+SHIP_CONFIG DefaultSHiPConfig();
+
+class SHIP_PREDICTOR
+{
+  private:
+
+    SHIP_CONFIG  config;
+    UINT32       entries;       // per table
+    UINT32       counterMax;
+    UINT32       laneShift;     // log2 of the lane width
+    UINT32       wordShift;     // log2 of the lanes per BITVECTOR
+    BITVECTOR   *counters;
+    UINT32       counterWords;
+    unsigned short *owner;      // tag of the last signature per entry, 0 if unused
+    BITVECTOR    history[ CRC_SHIP_MAX_THREADS ];
+    BITVECTOR    historyMask;
+
+    COUNTER      fills;
+    COUNTER      distantFills;
+    COUNTER      usedEntries;
+    COUNTER      aliasedFills;  // fills whose entry last served another signature
+    COUNTER      evictions[2][2];   // [predicted distant][reused]
+
+  public:
+
+    SHIP_PREDICTOR( const SHIP_CONFIG &_config );
+    ~SHIP_PREDICTOR();
+
+    const SHIP_CONFIG & Config() const { return config; }
+
+    // Entry of the counter table for a fill, also advances the history
+    UINT32  Signature( UINT32 tid, Addr_t PC, Addr_t paddr );
+
+    // Hits only advance the history of SHIP_SIG_ISEQ
+    void    Advance( UINT32 tid, Addr_t PC )
+    {
+        assert( tid < CRC_SHIP_MAX_THREADS );
+
+        if( config.source == SHIP_SIG_ISEQ )
+        {
+            history[ tid ] = ((history[ tid ] << 8) | (Hash( PC ) & 0xff)) & historyMask;
+        }
+    }
+
+    // Insert a fill of this signature with a distant RRPV?
+    bool    PredictDistant( UINT32 signature )
+    {
+        bool distant = GetCounter( signature ) == 0;
+
+        fills++;
+        distantFills += distant;
+
+        return distant;
+    }
+
+    void    Hit( UINT32 signature )
+    {
+        UINT32 value = GetCounter( signature );
+        if( value < counterMax ) SetCounter( signature, value + 1 );
+    }
+
+    // A line of this signature leaves the cache
+    void    Evict( UINT32 signature, bool reused, bool predictedDistant )
+    {
+        evictions[ predictedDistant ][ reused ]++;
+
+        if( reused ) return;
+
+        UINT32 value = GetCounter( signature );
+        if( value > 0 ) SetCounter( signature, value - 1 );
+    }
+
+    // Number of distinct signatures, all tables together
+    UINT32  Signatures() const { return config.tables * entries; }
+
+    // Bits of counter state, as a hardware table would need
+    COUNTER StorageBits() const { return (COUNTER) config.tables * entries * config.counterBits; }
+
+    ostream &   PrintStats( ostream &out );
+
+    // Fill, alias and eviction counters, named ship.*
+    void        RegisterStats( CRC_STATS_REGISTRY *registry );
+
+    // Zero those counters; the table and the used entries are kept
+    void        ResetStats();
+
+    // Counter table, histories and statistics (checkpoint.h); Restore fails
+    // unless the predictor has the configuration that was saved
+    void        Save( CRC_CHECKPOINT_WRITER *ckpt ) const;
+    bool        Restore( CRC_CHECKPOINT_READER *ckpt );
+
+  private:
+
+    static BITVECTOR Hash( BITVECTOR key )
+    {
+        // murmur3 64-bit finalizer
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+
+    UINT32  GetCounter( UINT32 entry ) const
+    {
+        BITVECTOR word = counters[ entry >> wordShift ];
+        return (UINT32) (word >> (((entry & ((1 << wordShift) - 1))) << laneShift)) & counterMax;
+    }
+
+    void    SetCounter( UINT32 entry, UINT32 value )
+    {
+        BITVECTOR &word  = counters[ entry >> wordShift ];
+        UINT32     shift = (entry & ((1 << wordShift) - 1)) << laneShift;
+        word = (word & ~((BITVECTOR) counterMax << shift)) | ((BITVECTOR) value << shift);
+    }
+
+    SHIP_PREDICTOR( const SHIP_PREDICTOR & );
+    SHIP_PREDICTOR & operator=( const SHIP_PREDICTOR & );
+};
+
+#endif
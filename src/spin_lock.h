@@ -0,0 +1,91 @@
+#ifndef CRC_SPIN_LOCK_H
+#define CRC_SPIN_LOCK_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Test-and-test-and-set spin lock for the short critical sections of the     //
+// shared cache mode (one cache access per set lock). Waiters spin on a       //
+// plain load so that the lock line stays shared until it is released, and    //
+// yield now and then so that oversubscribed runs still make progress.        //
+//                                                                            //
+// CRC_PADDED_SPIN_LOCK takes a cache line of its own so that an array of     //
+// them does not make threads working on neighbouring entries collide.        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <thread>
+#include "utils.h"
+
+#ifndef CRC_CACHE_LINE
+#define CRC_CACHE_LINE  64
+#endif
+
+#define CRC_SPIN_YIELD  1024        // spins between yields
+
+static inline void CRC_CpuRelax()
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile( "yield" );
+#endif
+}
+
+class CRC_SPIN_LOCK
+{
+  private:
+
+    atomic<bool>    locked;
+
+  public:
+
+    CRC_SPIN_LOCK() : locked( false ) {}
+
+    void Lock()
+    {
+        UINT32 spins = 0;
+
+        while( locked.exchange( true, memory_order_acquire ) )
+        {
+            while( locked.load( memory_order_relaxed ) )
+            {
+                if( ++spins % CRC_SPIN_YIELD == 0 ) this_thread::yield();
+                else                                CRC_CpuRelax();
+            }
+        }
+    }
+
+    void Unlock() { locked.store( false, memory_order_release ); }
+
+  private:
+
+    CRC_SPIN_LOCK( const CRC_SPIN_LOCK & );
+    CRC_SPIN_LOCK & operator=( const CRC_SPIN_LOCK & );
+};
+
+struct alignas(CRC_CACHE_LINE) CRC_PADDED_SPIN_LOCK
+{
+    CRC_SPIN_LOCK   lock;
+};
+
+// Holds the lock for the scope; a NULL lock is not taken
+class CRC_SPIN_GUARD
+{
+  private:
+
+    CRC_SPIN_LOCK  *lock;
+
+  public:
+
+    CRC_SPIN_GUARD( CRC_SPIN_LOCK *_lock ) : lock( _lock ) { if( lock ) lock->Lock(); }
+    ~CRC_SPIN_GUARD() { if( lock ) lock->Unlock(); }
+
+  private:
+
+    CRC_SPIN_GUARD( const CRC_SPIN_GUARD & );
+    CRC_SPIN_GUARD & operator=( const CRC_SPIN_GUARD & );
+};
+
+#endif
@@ -0,0 +1,115 @@
+#ifndef CRC_SPSC_QUEUE_H
+#define CRC_SPSC_QUEUE_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Bounded single-producer/single-consumer queue. Elements are moved in       //
+// bunches so that the two index updates (one per side) are amortized over    //
+// many elements. Head and tail live on their own cache lines, and each side  //
+// keeps a private copy of the other side's index that it only refreshes      //
+// when the queue looks full (producer) or empty (consumer).                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <atomic>
+#include <thread>
+#include <cassert>
+#include "utils.h"
+
+#define CRC_CACHE_LINE  64
+
+template <class T>
+class SPSC_QUEUE
+{
+  private:
+
+    T                           *ring;
+    COUNTER                      mask;
+
+    // Consumer side
+    alignas(CRC_CACHE_LINE) atomic<COUNTER>  head;
+    COUNTER                                  cachedTail;
+
+    // Producer side
+    alignas(CRC_CACHE_LINE) atomic<COUNTER>  tail;
+    COUNTER                                  cachedHead;
+
+  public:
+
+    // capacity must be a power of two
+    SPSC_QUEUE( COUNTER capacity )
+    {
+        assert( capacity && (capacity & (capacity - 1)) == 0 );
+
+        ring       = new T[ capacity ];
+        mask       = capacity - 1;
+        head       = 0;
+        tail       = 0;
+        cachedTail = 0;
+        cachedHead = 0;
+    }
+
+    ~SPSC_QUEUE() { delete [] ring; }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Producer: appends n elements, waiting for space as needed
+    ////////////////////////////////////////////////////////////////////////////
+    void Push( const T *elems, UINT32 n )
+    {
+        COUNTER t = tail.load( memory_order_relaxed );
+
+        while( n )
+        {
+            COUNTER room = mask + 1 - (t - cachedHead);
+            if( room == 0 )
+            {
+                cachedHead = head.load( memory_order_acquire );
+                room       = mask + 1 - (t - cachedHead);
+                if( room == 0 )
+                {
+                    this_thread::yield();
+                    continue;
+                }
+            }
+
+            UINT32 chunk = (n < room) ? n : (UINT32) room;
+            for(UINT32 i=0; i<chunk; i++) ring[ (t + i) & mask ] = elems[i];
+
+            t     += chunk;
+            elems += chunk;
+            n     -= chunk;
+            tail.store( t, memory_order_release );
+        }
+    }
+
+    ////////////////////////////////////////////////////////////////////////////
+    // Consumer: removes up to max elements, returns how many (0 if empty)
+    ////////////////////////////////////////////////////////////////////////////
+    UINT32 Pop( T *elems, UINT32 max )
+    {
+        COUNTER h     = head.load( memory_order_relaxed );
+        COUNTER avail = cachedTail - h;
+
+        if( avail == 0 )
+        {
+            cachedTail = tail.load( memory_order_acquire );
+            avail      = cachedTail - h;
+            if( avail == 0 ) return 0;
+        }
+
+        UINT32 n = (avail < max) ? (UINT32) avail : max;
+        for(UINT32 i=0; i<n; i++) elems[i] = ring[ (h + i) & mask ];
+
+        head.store( h + n, memory_order_release );
+
+        return n;
+    }
+
+  private:
+
+    SPSC_QUEUE( const SPSC_QUEUE & );
+    SPSC_QUEUE & operator=( const SPSC_QUEUE & );
+};
+
+#endif
@@ -0,0 +1,295 @@
+#include "stack_distance.h"
+
+#include <cstring>
+#include <algorithm>
+#include <iomanip>
+
+#define CRC_STACK_MIN_SLOTS  (1 << 20)   // initial timestamp range of the Fenwick tree
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The constructor sets up either the per-set stacks or, with _sets == 0,     //
+// the fully associative timestamp tree                                       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+CRC_STACK_DISTANCE::CRC_STACK_DISTANCE( UINT32 _sets, UINT32 _maxDepth, UINT32 _linesize )
+{
+    numsets   = _sets;
+    maxDepth  = _maxDepth;
+    linesize  = _linesize;
+    lineShift = CRC_FloorLog2( linesize );
+
+    assert( maxDepth > 0 );
+    assert( numsets == 0 || maxDepth <= CRC_STACK_MAXWAYS );
+
+    for(UINT32 a=0; a<ACCESS_MAX; a++)
+    {
+        hist[a]    = new COUNTER[ maxDepth + 1 ];
+        lookups[a] = 0;
+
+        for(UINT32 d=0; d<=maxDepth; d++) hist[a][d] = 0;
+    }
+    wbSplits = 0;
+
+    stacks     = NULL;
+    depth      = NULL;
+    stride     = 0;
+    match      = NULL;
+    indexShift = 0;
+    indexMask  = 0;
+    now        = 0;
+
+    if( numsets )
+    {
+        indexShift = CRC_FloorLog2( numsets );
+        indexMask  = (1 << indexShift) - 1;
+
+        // The match kernels compare whole groups of 8 tags
+        stride = (maxDepth + 7) & ~7;
+        stacks = new Addr_t[ (size_t) numsets * stride ];
+        depth  = new UINT32[ numsets ];
+        match  = SelectTagMatch();
+
+        memset( stacks, 0, (size_t) numsets * stride * sizeof(Addr_t) );
+        memset( depth, 0, numsets * sizeof(UINT32) );
+    }
+    else
+    {
+        fenwick.assign( CRC_STACK_MIN_SLOTS, 0 );
+    }
+}
+
+CRC_STACK_DISTANCE::~CRC_STACK_DISTANCE()
+{
+    for(UINT32 a=0; a<ACCESS_MAX; a++) delete [] hist[a];
+
+    delete [] stacks;
+    delete [] depth;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function records the stack depth of one access. Writeback hits leave   //
+// the stack untouched, as they leave the LRU state of CRC_CACHE untouched.   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_STACK_DISTANCE::Access( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType )
+{
+    bool   isWriteback = (accessType == ACCESS_WRITEBACK);
+    UINT32 d           = numsets ? AccessSet( paddr, !isWriteback ) : AccessFullyAssoc( paddr, !isWriteback );
+
+    lookups[ accessType ]++;
+    hist[ accessType ][ d ]++;
+
+    // Caches with at most d ways miss on this writeback and fill the line at
+    // MRU, unlike the larger ones
+    if( isWriteback && d > 0 && d < maxDepth ) wbSplits++;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Set-associative stacks: find the tag, return its depth and move it to the  //
+// top. A line that is not in the stack is pushed on top and the bottom       //
+// entry falls off once the stack holds maxDepth lines. Returns maxDepth for  //
+// such misses.                                                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+UINT32 CRC_STACK_DISTANCE::AccessSet( Addr_t paddr, bool update )
+{
+    Addr_t  line     = paddr >> lineShift;
+    UINT32  setIndex = line & indexMask;
+    Addr_t  tag      = line >> indexShift;
+    Addr_t *stack    = stacks + (size_t) setIndex * stride;
+    UINT32  n        = depth[ setIndex ];
+
+    BITVECTOR inStack = (n == 64) ? ~0ULL : ((1ULL << n) - 1);
+    BITVECTOR hits    = match( stack, stride, tag ) & inStack;
+
+    if( hits )
+    {
+        UINT32 d = __builtin_ctzll( hits );
+
+        if( update && d )
+        {
+            memmove( stack + 1, stack, d * sizeof(Addr_t) );
+            stack[0] = tag;
+        }
+        return d;
+    }
+
+    // Misses fill in every cache size, writebacks included
+    UINT32 keep = (n < maxDepth) ? n : maxDepth - 1;
+
+    memmove( stack + 1, stack, keep * sizeof(Addr_t) );
+    stack[0]            = tag;
+    depth[ setIndex ]   = keep + 1;
+
+    return maxDepth;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Fully associative: the depth of a line is the number of last-access        //
+// timestamps after its own, i.e. the number of distinct lines touched since  //
+// it was last touched                                                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+UINT32 CRC_STACK_DISTANCE::AccessFullyAssoc( Addr_t paddr, bool update )
+{
+    Addr_t line = paddr >> lineShift;
+
+    unordered_map<Addr_t, COUNTER>::iterator it = lastUse.find( line );
+
+    if( it == lastUse.end() )
+    {
+        if( now == fenwick.size() ) Compact();
+
+        FenwickAdd( now, 1 );
+        lastUse[ line ] = now++;
+
+        return maxDepth;
+    }
+
+    COUNTER d = FenwickPrefix( now ) - FenwickPrefix( it->second + 1 );
+
+    if( update )
+    {
+        // Compaction renumbers the timestamps but keeps their order
+        if( now == fenwick.size() ) Compact();
+
+        FenwickAdd( it->second, -1 );
+        FenwickAdd( now, 1 );
+        it->second = now++;
+    }
+
+    return (d < maxDepth) ? (UINT32) d : maxDepth;
+}
+
+void CRC_STACK_DISTANCE::FenwickAdd( COUNTER slot, int delta )
+{
+    for(COUNTER i=slot+1; i<=fenwick.size(); i+=i&(~i+1)) fenwick[i-1] += delta;
+}
+
+COUNTER CRC_STACK_DISTANCE::FenwickPrefix( COUNTER slot ) const
+{
+    COUNTER sum = 0;
+
+    for(COUNTER i=slot; i>0; i-=i&(~i+1)) sum += fenwick[i-1];
+
+    return sum;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function renumbers the last-access timestamps to 0..lines-1 in order   //
+// once the tree runs out of timestamps, and leaves at least as many free     //
+// timestamps as there are lines                                              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_STACK_DISTANCE::Compact()
+{
+    vector< pair<COUNTER, COUNTER *> > order;
+
+    order.reserve( lastUse.size() );
+    for(unordered_map<Addr_t, COUNTER>::iterator it=lastUse.begin(); it!=lastUse.end(); ++it)
+    {
+        order.push_back( make_pair( it->second, &it->second ) );
+    }
+    sort( order.begin(), order.end() );
+
+    COUNTER slots = CRC_STACK_MIN_SLOTS;
+    while( slots < 2 * order.size() ) slots *= 2;
+
+    fenwick.assign( slots, 0 );
+    for(COUNTER i=0; i<order.size(); i++)
+    {
+        *order[i].second = i;
+        FenwickAdd( i, 1 );
+    }
+    now = order.size();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Miss counts for an LRU cache with the given number of ways: every access   //
+// deeper than ways misses                                                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+COUNTER CRC_STACK_DISTANCE::Misses( UINT32 ways, UINT32 accessType ) const
+{
+    COUNTER hits = 0;
+
+    assert( ways <= maxDepth );
+
+    for(UINT32 d=0; d<ways; d++) hits += hist[ accessType ][ d ];
+
+    return lookups[ accessType ] - hits;
+}
+
+COUNTER CRC_STACK_DISTANCE::DemandLookups() const
+{
+    COUNTER stat = 0;
+    for(UINT32 a=0; a<=ACCESS_STORE; a++) stat += lookups[a];
+    return stat;
+}
+
+COUNTER CRC_STACK_DISTANCE::DemandMisses( UINT32 ways ) const
+{
+    COUNTER stat = 0;
+    for(UINT32 a=0; a<=ACCESS_STORE; a++) stat += Misses( ways, a );
+    return stat;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function prints the LRU miss curve: one row per associativity, or per  //
+// power-of-two number of lines for a fully associative analysis              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+ostream & CRC_STACK_DISTANCE::PrintStats( ostream &out )
+{
+    COUNTER totLookups = 0;
+
+    for(UINT32 a=0; a<ACCESS_MAX; a++) totLookups += lookups[a];
+
+    out<<"=========================================================="<<endl;
+    out<<"==== Cache Replacement Championship -- LRU Miss Curve ===="<<endl;
+    out<<"=========================================================="<<endl;
+    out<<endl;
+    out<<"Stack Configuration: "<<endl;
+    if( numsets ) out<<"\tTot # Sets:     "<<numsets<<endl;
+    else          out<<"\tTot # Sets:     fully associative"<<endl;
+    out<<"\tLine Size:      "<<linesize<<"B"<<endl;
+    out<<"\tMax Depth:      "<<maxDepth<<endl;
+    out<<"\tAccesses:       "<<totLookups<<endl;
+    out<<"\tSplit WBs:      "<<wbSplits<<endl;
+    out<<endl;
+
+    out<<right<<setw(8)<<(numsets ? "Assoc" : "Lines")<<setw(10)<<"Size"<<setw(14)<<"Misses"
+       <<setw(11)<<"Miss Rate"<<setw(14)<<"Demand Misses"<<setw(13)<<"Demand Rate"<<endl;
+
+    COUNTER demLookups = DemandLookups();
+
+    for(UINT32 ways=1; ways<=maxDepth; ways++)
+    {
+        // Fully associative curves only list powers of two and the maximum
+        if( !numsets && (ways & (ways - 1)) != 0 && ways != maxDepth ) continue;
+
+        COUNTER size      = (COUNTER) (numsets ? numsets : 1) * ways * linesize;
+        COUNTER misses    = 0;
+        COUNTER demMisses = DemandMisses( ways );
+
+        for(UINT32 a=0; a<ACCESS_MAX; a++) misses += Misses( ways, a );
+
+        out<<setw(8)<<ways;
+        if( size % 1024 == 0 ) out<<setw(9)<<(size >> 10)<<"K";
+        else                   out<<setw(9)<<size<<"B";
+        out<<setw(14)<<misses
+           <<setw(11)<<(totLookups ? (double)misses/(double)totLookups*100.0 : 0.0)
+           <<setw(14)<<demMisses
+           <<setw(13)<<(demLookups ? (double)demMisses/(double)demLookups*100.0 : 0.0)<<endl;
+    }
+    out<<endl;
+
+    return out;
+}
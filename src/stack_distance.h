@@ -0,0 +1,100 @@
+#ifndef CRC_STACK_DISTANCE_H
+#define CRC_STACK_DISTANCE_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// One-pass LRU stack distance (Mattson) analysis. For a fixed number of      //
+// sets, an access that finds its line at depth d of the set's LRU stack      //
+// hits in every LRU cache with more than d ways and misses in all others,    //
+// so one histogram of depths gives the miss count of every associativity     //
+// up to maxDepth at once.                                                    //
+//                                                                            //
+//   set-associative   every set keeps a bounded move-to-front stack of       //
+//                     maxDepth tags, searched with the tag match kernel      //
+//                     of the tag store (tag_match.h); maxDepth <= 64         //
+//   fully associative numsets == 0; the depth of a line is the number of     //
+//                     distinct lines touched since its last access, counted  //
+//                     with a Fenwick tree over access timestamps             //
+//                                                                            //
+// Like CRC_CACHE, a writeback that hits does not update recency. This is     //
+// only exact for the caches in which the writeback actually hits: in a       //
+// cache with no more ways than the depth it misses and is filled at MRU,     //
+// which no single stack can represent. WritebackSplits() counts such         //
+// writebacks to show how far the curve may be off from CRC_CACHE.            //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include <vector>
+#include <unordered_map>
+#include "utils.h"
+#include "crc_cache_defs.h"
+#include "tag_match.h"
+
+#define CRC_STACK_MAXWAYS   64        // set stacks are searched as one tag set
+
+class CRC_STACK_DISTANCE
+{
+  private:
+
+    UINT32      numsets;        // 0 for fully associative
+    UINT32      linesize;
+    UINT32      maxDepth;       // deepest stack position tracked
+    UINT32      lineShift;
+    UINT32      indexShift;
+    UINT32      indexMask;
+
+    // depth histogram per access type; slot maxDepth counts misses in all
+    // tracked sizes (cold misses and deeper reuse)
+    COUNTER    *hist[ ACCESS_MAX ];
+    COUNTER     lookups[ ACCESS_MAX ];
+    COUNTER     wbSplits;
+
+    // set-associative: per-set stacks, MRU first
+    Addr_t     *stacks;
+    UINT32     *depth;          // valid entries per stack
+    UINT32      stride;
+    TAG_MATCH_FN match;
+
+    // fully associative: line -> timestamp of its last access, and a Fenwick
+    // tree with a one at the timestamp of every line's last access
+    unordered_map<Addr_t, COUNTER>  lastUse;
+    vector<UINT32>                  fenwick;
+    COUNTER                         now;
+
+  public:
+
+    CRC_STACK_DISTANCE( UINT32 _sets, UINT32 _maxDepth, UINT32 _linesize=64 );
+    ~CRC_STACK_DISTANCE();
+
+    void    Access( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType );
+
+    // Results for an LRU cache with the given number of ways (lines for a
+    // fully associative analysis), ways <= maxDepth
+    COUNTER Lookups( UINT32 accessType ) const { return lookups[ accessType ]; }
+    COUNTER Misses( UINT32 ways, UINT32 accessType ) const;
+    COUNTER DemandLookups() const;
+    COUNTER DemandMisses( UINT32 ways ) const;
+
+    COUNTER WritebackSplits() const { return wbSplits; }
+    UINT32  NumSets() const { return numsets; }
+    UINT32  MaxDepth() const { return maxDepth; }
+
+    // Miss curve over all associativities (powers of two for fully associative)
+    ostream &   PrintStats( ostream &out );
+
+  private:
+
+    UINT32  AccessSet( Addr_t paddr, bool update );
+    UINT32  AccessFullyAssoc( Addr_t paddr, bool update );
+
+    void    FenwickAdd( COUNTER slot, int delta );
+    COUNTER FenwickPrefix( COUNTER slot ) const;    // sum of slots [0, slot)
+    void    Compact();
+
+    CRC_STACK_DISTANCE( const CRC_STACK_DISTANCE & );
+    CRC_STACK_DISTANCE & operator=( const CRC_STACK_DISTANCE & );
+};
+
+#endif
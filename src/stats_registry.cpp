@@ -0,0 +1,144 @@
+#include "stats_registry.h"
+
+#include <cstring>
+#include <strings.h>
+#include <cassert>
+
+void CRC_STATS_REGISTRY::Register( const string &name, const COUNTER *counter )
+{
+    STAT stat = { name, counter, function<COUNTER()>() };
+
+    assert( counter != NULL );
+    stats.push_back( stat );
+}
+
+void CRC_STATS_REGISTRY::Register( const string &name, function<COUNTER()> read )
+{
+    STAT stat = { name, NULL, read };
+
+    assert( read );
+    stats.push_back( stat );
+}
+
+CRC_STATS_WRITER::CRC_STATS_WRITER()
+{
+    format  = STATS_CSV;
+    closing = false;
+}
+
+CRC_STATS_WRITER::~CRC_STATS_WRITER()
+{
+    Close();
+}
+
+StatsFormat CRC_STATS_WRITER::FormatOf( const char *path )
+{
+    size_t length = strlen( path );
+
+    return (length >= 4 && strcasecmp( path + length - 4, ".csv" ) == 0) ? STATS_CSV : STATS_JSON;
+}
+
+bool CRC_STATS_WRITER::Open( const char *path, StatsFormat _format, const CRC_STATS_REGISTRY &registry )
+{
+    assert( !out.is_open() );
+
+    out.open( path );
+    if( !out )
+    {
+        cerr<<"cannot write "<<path<<endl;
+        return false;
+    }
+
+    format = _format;
+    names.clear();
+    for(UINT32 i=0; i<registry.Size(); i++) names.push_back( registry.Name(i) );
+
+    if( format == STATS_CSV )
+    {
+        out<<"accesses";
+        for(UINT32 i=0; i<names.size(); i++) out<<","<<names[i];
+        out<<"\n";
+    }
+
+    closing = false;
+    writer  = thread( &CRC_STATS_WRITER::WriterLoop, this );
+
+    return true;
+}
+
+void CRC_STATS_WRITER::Push( COUNTER accesses, const CRC_STATS_REGISTRY &registry )
+{
+    SNAPSHOT snapshot;
+
+    assert( out.is_open() && registry.Size() == names.size() );
+
+    snapshot.accesses = accesses;
+    snapshot.values.resize( registry.Size() );
+    registry.Sample( snapshot.values.data() );
+
+    {
+        lock_guard<mutex> guard( queueLock );
+        queue.push_back( move( snapshot ) );
+    }
+    queueReady.notify_one();
+}
+
+bool CRC_STATS_WRITER::Close()
+{
+    if( !out.is_open() ) return true;
+
+    {
+        lock_guard<mutex> guard( queueLock );
+        closing = true;
+    }
+    queueReady.notify_one();
+    writer.join();
+
+    out.close();
+
+    return !out.fail();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Writer thread: formats the queued snapshots until Close, flushing after    //
+// every batch so that readers see whole rows                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_STATS_WRITER::WriterLoop()
+{
+    unique_lock<mutex> guard( queueLock );
+
+    for( ;; )
+    {
+        queueReady.wait( guard, [this] { return closing || !queue.empty(); } );
+
+        if( queue.empty() ) return;     // closing
+
+        deque<SNAPSHOT> batch;
+        batch.swap( queue );
+
+        guard.unlock();
+        for(UINT32 i=0; i<batch.size(); i++) Write( batch[i] );
+        out.flush();
+        guard.lock();
+    }
+}
+
+void CRC_STATS_WRITER::Write( const SNAPSHOT &snapshot )
+{
+    if( format == STATS_CSV )
+    {
+        out<<snapshot.accesses;
+        for(UINT32 i=0; i<names.size(); i++) out<<","<<snapshot.values[i];
+        out<<"\n";
+        return;
+    }
+
+    out<<"{\"accesses\": "<<snapshot.accesses;
+    for(UINT32 i=0; i<names.size(); i++)
+    {
+        out<<", \""<<names[i]<<"\": "<<snapshot.values[i];
+    }
+    out<<"}\n";
+}
@@ -0,0 +1,115 @@
+#ifndef CRC_STATS_REGISTRY_H
+#define CRC_STATS_REGISTRY_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Machine-readable statistics. CRC_CACHE and the replacement state register  //
+// their counters by name in a CRC_STATS_REGISTRY; a snapshot copies the      //
+// current value of every counter into a row, which is all the simulation     //
+// thread pays. CRC_STATS_WRITER formats the rows on a background thread,     //
+// as CSV (a header of the names, then one line per snapshot) or as JSON      //
+// lines (one object per snapshot), so the file can be read while the         //
+// simulation runs.                                                           //
+//                                                                            //
+// Names are dot-separated paths, e.g. t0.LOAD.misses or duel.SRRIP.misses.   //
+// Every row starts with the number of accesses simulated so far.             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <fstream>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "utils.h"
+
+enum StatsFormat
+{
+    STATS_CSV   = 0,
+    STATS_JSON  = 1     // JSON lines
+};
+
+class CRC_STATS_REGISTRY
+{
+  private:
+
+    // A counter is read through its address, or through read for values
+    // that are not kept as a COUNTER
+    typedef struct
+    {
+        string                  name;
+        const COUNTER          *counter;
+        function<COUNTER()>     read;
+    } STAT;
+
+    vector<STAT>    stats;
+
+  public:
+
+    void    Register( const string &name, const COUNTER *counter );
+    void    Register( const string &name, function<COUNTER()> read );
+
+    UINT32          Size() const { return stats.size(); }
+    const string &  Name( UINT32 i ) const { return stats[i].name; }
+
+    // Current value of every counter, in registration order
+    void    Sample( COUNTER *values ) const
+    {
+        for(UINT32 i=0; i<stats.size(); i++)
+        {
+            values[i] = stats[i].counter ? *stats[i].counter : stats[i].read();
+        }
+    }
+};
+
+class CRC_STATS_WRITER
+{
+  private:
+
+    typedef struct
+    {
+        COUNTER             accesses;
+        vector<COUNTER>     values;
+    } SNAPSHOT;
+
+    ofstream                out;
+    StatsFormat             format;
+    vector<string>          names;
+
+    // Rows handed over by Push, written by the writer thread
+    deque<SNAPSHOT>         queue;
+    bool                    closing;
+    mutex                   queueLock;
+    condition_variable      queueReady;
+    thread                  writer;
+
+  public:
+
+    CRC_STATS_WRITER();
+    ~CRC_STATS_WRITER();
+
+    // Open path for the counters of registry, which must not grow any more
+    bool    Open( const char *path, StatsFormat _format, const CRC_STATS_REGISTRY &registry );
+
+    // Queue a snapshot of registry after accesses accesses
+    void    Push( COUNTER accesses, const CRC_STATS_REGISTRY &registry );
+
+    // Write the queued snapshots and close the file; false on write errors
+    bool    Close();
+
+    // .csv files are CSV, anything else JSON lines
+    static StatsFormat FormatOf( const char *path );
+
+  private:
+
+    void    WriterLoop();
+    void    Write( const SNAPSHOT &snapshot );
+
+    CRC_STATS_WRITER( const CRC_STATS_WRITER & );
+    CRC_STATS_WRITER & operator=( const CRC_STATS_WRITER & );
+};
+
+#endif
@@ -0,0 +1,247 @@
+#include "sweep_sim.h"
+
+#include <cstring>
+#include <iomanip>
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The constructor creates the caches of all configurations and one worker    //
+// thread per group. There are never more groups than configurations.         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+CRC_SWEEP::CRC_SWEEP( const vector<SWEEP_CONFIG> &_configs, UINT32 _tpc, UINT32 _groups )
+{
+    configs   = _configs;
+    threads   = _tpc;
+    numGroups = _groups < configs.size() ? _groups : configs.size();
+
+    assert( numGroups > 0 );
+
+    for(UINT32 c=0; c<configs.size(); c++)
+    {
+        caches.push_back( new CRC_CACHE( configs[c].cacheSize, configs[c].assoc, threads,
+                                         configs[c].linesize, configs[c].replPolicy ) );
+    }
+
+    for(UINT32 s=0; s<SWEEP_SLOTS; s++)
+    {
+        slots[s]       = new TRACE_RECORD[ SWEEP_SLOT_RECORDS ];
+        slotRecords[s] = 0;
+        slotRefs[s]    = 0;
+    }
+
+    published = 0;
+    done      = false;
+    fill      = NULL;
+    filled    = 0;
+
+    for(UINT32 g=0; g<numGroups; g++)
+    {
+        workers.push_back( thread( &CRC_SWEEP::WorkerLoop, this, g ) );
+    }
+}
+
+CRC_SWEEP::~CRC_SWEEP()
+{
+    Finish();
+
+    for(UINT32 c=0; c<caches.size(); c++) delete caches[c];
+    for(UINT32 s=0; s<SWEEP_SLOTS; s++) delete [] slots[s];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function waits until the slot of the next batch has been released by   //
+// all groups and makes it the slot being filled                              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_SWEEP::AcquireSlot()
+{
+    UINT32 s = published % SWEEP_SLOTS;
+
+    unique_lock<mutex> guard( lock );
+    while( slotRefs[s] != 0 )
+    {
+        slotFree.wait( guard );
+    }
+
+    fill   = slots[s];
+    filled = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function hands the slot being filled to all groups                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_SWEEP::Publish()
+{
+    UINT32 s = published % SWEEP_SLOTS;
+
+    {
+        unique_lock<mutex> guard( lock );
+        slotRecords[s] = filled;
+        slotRefs[s]    = numGroups;
+        published++;
+    }
+    batchReady.notify_all();
+
+    fill   = NULL;
+    filled = 0;
+}
+
+void CRC_SWEEP::Access( const TRACE_RECORD *recs, UINT32 n )
+{
+    while( n )
+    {
+        if( fill == NULL ) AcquireSlot();
+
+        UINT32 chunk = SWEEP_SLOT_RECORDS - filled;
+        if( chunk > n ) chunk = n;
+
+        memcpy( fill + filled, recs, chunk * sizeof(TRACE_RECORD) );
+        filled += chunk;
+        recs   += chunk;
+        n      -= chunk;
+
+        if( filled == SWEEP_SLOT_RECORDS ) Publish();
+    }
+}
+
+void CRC_SWEEP::Finish()
+{
+    if( workers.empty() ) return;
+
+    if( filled ) Publish();
+
+    {
+        unique_lock<mutex> guard( lock );
+        done = true;
+    }
+    batchReady.notify_all();
+
+    for(UINT32 g=0; g<numGroups; g++)
+    {
+        workers[g].join();
+    }
+    workers.clear();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Body of a worker thread: replay every published batch through the caches   //
+// of the group, one cache at a time so that each keeps its state hot, then   //
+// release the slot. The first batch moves the caches of the group to the     //
+// NUMA node of the worker.                                                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CRC_SWEEP::WorkerLoop( UINT32 group )
+{
+    vector<CRC_CACHE *> mine;
+    COUNTER             next = 0;
+
+    for(UINT32 c=group; c<caches.size(); c+=numGroups) mine.push_back( caches[c] );
+
+    while( true )
+    {
+        {
+            unique_lock<mutex> guard( lock );
+            while( published == next && !done )
+            {
+                batchReady.wait( guard );
+            }
+            if( published == next ) break;
+        }
+
+        UINT32              s    = next % SWEEP_SLOTS;
+        const TRACE_RECORD *recs = slots[s];
+        UINT32              n    = slotRecords[s];
+
+        // The caches are configured by now; make them local to this thread
+        if( next == 0 )
+        {
+            for(UINT32 c=0; c<mine.size(); c++) mine[c]->MoveToLocalNode();
+        }
+
+        for(UINT32 c=0; c<mine.size(); c++)
+        {
+            mine[c]->LookupAndFillBatch( recs, n );
+        }
+
+        bool last;
+        {
+            unique_lock<mutex> guard( lock );
+            last = (--slotRefs[s] == 0);
+        }
+        if( last ) slotFree.notify_one();
+
+        next++;
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function prints one row per configuration with the overall and the     //
+// demand (ifetch, load, store) miss rates. In verbose mode the complete      //
+// statistics of every configuration follow the table.                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+ostream & CRC_SWEEP::PrintStats( ostream &out, bool verbose )
+{
+    out<<"=========================================================="<<endl;
+    out<<"==== Cache Replacement Championship -- LLC Sweep       ===="<<endl;
+    out<<"=========================================================="<<endl;
+    out<<endl;
+
+    out<<right<<setw(8)<<"Size"<<setw(7)<<"Assoc"<<setw(6)<<"Line"<<"  "<<left<<setw(9)<<"Policy"
+       <<right<<setw(14)<<"Accesses"<<setw(14)<<"Misses"<<setw(11)<<"Miss Rate"
+       <<setw(14)<<"Demand Misses"<<setw(13)<<"Demand Rate"<<endl;
+
+    for(UINT32 c=0; c<configs.size(); c++)
+    {
+        CRC_CACHE *cache = caches[c];
+        COUNTER totLookups = 0, totMisses = 0, demLookups = 0, demMisses = 0;
+
+        for(UINT32 t=0; t<threads; t++)
+        {
+            for(UINT32 a=0; a<ACCESS_MAX; a++)
+            {
+                totLookups += cache->LookupStats( a, t );
+                totMisses  += cache->MissStats( a, t );
+            }
+            demLookups += cache->ThreadDemandLookupStats( t );
+            demMisses  += cache->ThreadDemandMissStats( t );
+        }
+
+        out<<right<<setw(7)<<(configs[c].cacheSize >> 10)<<"K"<<setw(7)<<configs[c].assoc
+           <<setw(6)<<configs[c].linesize<<"  "<<left<<setw(9)<<crc_repl_names[ configs[c].replPolicy ]
+           <<right<<setw(14)<<totLookups<<setw(14)<<totMisses;
+
+        // Sampled caches report the extrapolated rates and their 95% CI
+        double rate, halfWidth, demandRate, demandHalfWidth;
+
+        if( cache->SampledMissRate( false, &rate, &halfWidth ) )
+        {
+            cache->SampledMissRate( true, &demandRate, &demandHalfWidth );
+
+            out<<setw(11)<<rate*100.0<<setw(14)<<demMisses<<setw(13)<<demandRate*100.0
+               <<"  +- "<<demandHalfWidth*100.0<<endl;
+            continue;
+        }
+
+        out<<setw(11)<<(totLookups ? (double)totMisses/(double)totLookups*100.0 : 0.0)
+           <<setw(14)<<demMisses
+           <<setw(13)<<(demLookups ? (double)demMisses/(double)demLookups*100.0 : 0.0)<<endl;
+    }
+    out<<endl;
+
+    if( verbose )
+    {
+        for(UINT32 c=0; c<configs.size(); c++)
+        {
+            caches[c]->PrintStats( out );
+        }
+    }
+
+    return out;
+}
@@ -0,0 +1,93 @@
+#ifndef CRC_SWEEP_SIM_H
+#define CRC_SWEEP_SIM_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Single-pass simulation of many LLC configurations. The trace is decoded    //
+// once; the dispatching thread copies the records into a small ring of       //
+// shared batch slots and every worker thread replays each slot through its   //
+// group of CRC_CACHE instances (configurations are dealt round-robin to the  //
+// groups). A slot is reused once all groups are done with it.                //
+//                                                                            //
+// Every configuration sees the complete access stream in trace order and     //
+// draws from its own random stream, so its results are identical to a        //
+// separate run with the same parameters.                                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "crc_cache.h"
+#include "trace.h"
+
+#define SWEEP_SLOTS           4           // batch slots in flight
+#define SWEEP_SLOT_RECORDS    (1 << 16)   // records per batch slot
+
+// One cache configuration of a sweep, in CRC_CACHE constructor terms
+typedef struct
+{
+    UINT32      cacheSize;
+    UINT32      assoc;
+    UINT32      linesize;
+    UINT32      replPolicy;
+} SWEEP_CONFIG;
+
+class CRC_SWEEP
+{
+  private:
+
+    UINT32                  threads;
+    UINT32                  numGroups;
+
+    vector<SWEEP_CONFIG>    configs;
+    vector<CRC_CACHE *>     caches;
+    vector<thread>          workers;
+
+    // Batch slots; slot s holds batch number b for b % SWEEP_SLOTS == s
+    TRACE_RECORD           *slots[ SWEEP_SLOTS ];
+    UINT32                  slotRecords[ SWEEP_SLOTS ];
+    UINT32                  slotRefs[ SWEEP_SLOTS ];     // groups still reading the slot
+    COUNTER                 published;                   // batches handed to the workers
+    bool                    done;
+
+    mutex                   lock;
+    condition_variable      batchReady;
+    condition_variable      slotFree;
+
+    // Dispatcher side: the slot being filled
+    TRACE_RECORD           *fill;
+    UINT32                  filled;
+
+  public:
+
+    CRC_SWEEP( const vector<SWEEP_CONFIG> &_configs, UINT32 _tpc, UINT32 _groups );
+    ~CRC_SWEEP();
+
+    // Dispatcher: feed n records to every configuration
+    void   Access( const TRACE_RECORD *recs, UINT32 n );
+
+    // Hand out the last partial batch and wait for the workers; must be
+    // called before the statistics are read
+    void   Finish();
+
+    // One row per configuration; verbose adds the full PrintStats of each
+    ostream &   PrintStats( ostream &out, bool verbose=false );
+
+    UINT32 NumConfigs() const { return configs.size(); }
+    UINT32 NumGroups() const { return numGroups; }
+    CRC_CACHE * Cache( UINT32 c ) { return caches[c]; }
+
+  private:
+
+    void   AcquireSlot();
+    void   Publish();
+    void   WorkerLoop( UINT32 group );
+
+    CRC_SWEEP( const CRC_SWEEP & );
+    CRC_SWEEP & operator=( const CRC_SWEEP & );
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "tag_match.h"
+
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define CRC_TAG_MATCH_X86
+#include <immintrin.h>
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Portable fallback, one way at a time                                       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+static BITVECTOR TagMatchScalar( const Addr_t *setTags, UINT32 ways, Addr_t tag )
+{
+    BITVECTOR match = 0;
+
+    for(UINT32 way=0; way<ways; way++)
+    {
+        match |= (BITVECTOR) (setTags[way] == tag) << way;
+    }
+
+    return match;
+}
+
+#ifdef CRC_TAG_MATCH_X86
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// SSE2 has no 64-bit compare: compare the 32-bit halves and AND each half    //
+// with its neighbour, then take one sign bit per 64-bit lane                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+__attribute__((target("sse2")))
+static BITVECTOR TagMatchSSE2( const Addr_t *setTags, UINT32 ways, Addr_t tag )
+{
+    const __m128i key   = _mm_set1_epi64x( (long long) tag );
+    BITVECTOR     match = 0;
+
+    for(UINT32 way=0; way<ways; way+=2)
+    {
+        __m128i eq32 = _mm_cmpeq_epi32( _mm_load_si128( (const __m128i *) (setTags + way) ), key );
+        __m128i eq64 = _mm_and_si128( eq32, _mm_shuffle_epi32( eq32, _MM_SHUFFLE(2,3,0,1) ) );
+
+        match |= (BITVECTOR) _mm_movemask_pd( _mm_castsi128_pd( eq64 ) ) << way;
+    }
+
+    return match;
+}
+
+__attribute__((target("avx2")))
+static BITVECTOR TagMatchAVX2( const Addr_t *setTags, UINT32 ways, Addr_t tag )
+{
+    const __m256i key   = _mm256_set1_epi64x( (long long) tag );
+    BITVECTOR     match = 0;
+
+    for(UINT32 way=0; way<ways; way+=4)
+    {
+        __m256i eq = _mm256_cmpeq_epi64( _mm256_load_si256( (const __m256i *) (setTags + way) ), key );
+
+        match |= (BITVECTOR) _mm256_movemask_pd( _mm256_castsi256_pd( eq ) ) << way;
+    }
+
+    return match;
+}
+
+__attribute__((target("avx512f")))
+static BITVECTOR TagMatchAVX512( const Addr_t *setTags, UINT32 ways, Addr_t tag )
+{
+    const __m512i key   = _mm512_set1_epi64( (long long) tag );
+    BITVECTOR     match = 0;
+
+    for(UINT32 way=0; way<ways; way+=8)
+    {
+        __mmask8 eq = _mm512_cmpeq_epi64_mask( _mm512_load_si512( (const void *) (setTags + way) ), key );
+
+        match |= (BITVECTOR) eq << way;
+    }
+
+    return match;
+}
+
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Kernel table, best first                                                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+typedef struct
+{
+    const char    *name;
+    TAG_MATCH_FN   fn;
+    bool           (*supported)();
+} TAG_MATCH_KERNEL;
+
+static bool Always() { return true; }
+
+#ifdef CRC_TAG_MATCH_X86
+static bool HasSSE2()   { return __builtin_cpu_supports( "sse2" ); }
+static bool HasAVX2()   { return __builtin_cpu_supports( "avx2" ); }
+static bool HasAVX512() { return __builtin_cpu_supports( "avx512f" ); }
+#endif
+
+static const TAG_MATCH_KERNEL tag_match_kernels[] =
+{
+#ifdef CRC_TAG_MATCH_X86
+    { "avx512", TagMatchAVX512, HasAVX512 },
+    { "avx2",   TagMatchAVX2,   HasAVX2   },
+    { "sse2",   TagMatchSSE2,   HasSSE2   },
+#endif
+    { "scalar", TagMatchScalar, Always    }
+};
+
+#define NUM_TAG_MATCH_KERNELS (sizeof(tag_match_kernels) / sizeof(tag_match_kernels[0]))
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function picks the best supported kernel, or the one named by          //
+// CRC_TAG_MATCH if that is supported                                         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+TAG_MATCH_FN SelectTagMatch()
+{
+    const char *want = getenv( "CRC_TAG_MATCH" );
+
+    if( want )
+    {
+        for(UINT32 k=0; k<NUM_TAG_MATCH_KERNELS; k++)
+        {
+            if( strcmp( want, tag_match_kernels[k].name ) == 0 && tag_match_kernels[k].supported() )
+            {
+                return tag_match_kernels[k].fn;
+            }
+        }
+
+        cerr<<"CRC_TAG_MATCH="<<want<<" is not available on this host, using the default"<<endl;
+    }
+
+    for(UINT32 k=0; k<NUM_TAG_MATCH_KERNELS; k++)
+    {
+        if( tag_match_kernels[k].supported() ) return tag_match_kernels[k].fn;
+    }
+
+    return TagMatchScalar;
+}
+
+const char * TagMatchName( TAG_MATCH_FN fn )
+{
+    for(UINT32 k=0; k<NUM_TAG_MATCH_KERNELS; k++)
+    {
+        if( tag_match_kernels[k].fn == fn ) return tag_match_kernels[k].name;
+    }
+
+    return "unknown";
+}
@@ -0,0 +1,28 @@
+#ifndef CRC_TAG_MATCH_H
+#define CRC_TAG_MATCH_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Vectorized tag compare for CRC_TAG_STORE. A kernel compares tag against    //
+// all ways of one set and returns a bitmask with bit w set if way w holds    //
+// tag; the caller masks it with the valid bits and takes the lowest set bit. //
+// ways is the padded set stride of the tag store, always a multiple of 8,    //
+// so kernels never need a scalar tail.                                       //
+//                                                                            //
+// The kernel is picked once at startup from what the host supports:          //
+// AVX-512 (8 tags per compare), AVX2 (4), SSE2 (2) or plain scalar code.     //
+// Setting CRC_TAG_MATCH=scalar|sse2|avx2|avx512 in the environment forces a  //
+// particular kernel (if the host supports it).                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "utils.h"
+
+typedef BITVECTOR (*TAG_MATCH_FN)( const Addr_t *setTags, UINT32 ways, Addr_t tag );
+
+// Returns the kernel to use on this host, and its name
+TAG_MATCH_FN  SelectTagMatch();
+const char *  TagMatchName( TAG_MATCH_FN fn );
+
+#endif
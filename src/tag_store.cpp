@@ -0,0 +1,58 @@
+#include "tag_store.h"
+
+static inline size_t AlignUp( size_t bytes )
+{
+    return (bytes + CRC_TAG_STORE_ALIGN - 1) & ~(size_t) (CRC_TAG_STORE_ALIGN - 1);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The constructor carves the tag, valid, dirty and sharing arrays out of     //
+// one block of the cache's arena and starts off with every line invalid      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+CRC_TAG_STORE::CRC_TAG_STORE( UINT32 _sets, UINT32 _assoc, CRC_ARENA *arena )
+{
+    const UINT32 tagsPerLine = CRC_TAG_STORE_ALIGN / sizeof(Addr_t);
+
+    assert( _assoc > 0 && _assoc <= CRC_TAG_STORE_MAXWAYS );
+
+    numsets  = _sets;
+    assoc    = _assoc;
+    stride   = (assoc + tagsPerLine - 1) / tagsPerLine * tagsPerLine;
+    waysMask = (assoc == 64) ? ~0ULL : ((1ULL << assoc) - 1);
+
+    // Pick the tag compare kernel once per process
+    static TAG_MATCH_FN hostMatch = SelectTagMatch();
+    match = hostMatch;
+
+    size_t tagBytes     = AlignUp( (size_t) numsets * stride * sizeof(Addr_t) );
+    size_t maskBytes    = AlignUp( (size_t) numsets * sizeof(BITVECTOR) );
+    size_t sharingBytes = AlignUp( (size_t) numsets * assoc * sizeof(BITVECTOR) );
+
+    baseBytes = tagBytes + 2 * maskBytes + sharingBytes;
+
+    // Zeroed, padding included, which checkpoints copy along
+    base = arena->Alloc( baseBytes );
+
+    char *p = (char *) base;
+    tags    = (Addr_t *) p;     p += tagBytes;
+    valid   = (BITVECTOR *) p;  p += maskBytes;
+    dirty   = (BITVECTOR *) p;  p += maskBytes;
+    sharing = (BITVECTOR *) p;
+
+    // valid, dirty and sharing start out zero
+    for(size_t i=0; i<(size_t) numsets * stride; i++) tags[i] = CRC_INVALID_TAG;
+}
+
+// Tags, valid, dirty and sharing bits are one allocation of a layout fixed by
+// the geometry, so they are saved and restored as a single block
+void CRC_TAG_STORE::Save( CRC_CHECKPOINT_WRITER *ckpt ) const
+{
+    ckpt->Section( CKPT_TAG_STORE, base, baseBytes );
+}
+
+bool CRC_TAG_STORE::Restore( CRC_CHECKPOINT_READER *ckpt )
+{
+    return ckpt->Read( CKPT_TAG_STORE, base, baseBytes );
+}
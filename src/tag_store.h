@@ -0,0 +1,148 @@
+#ifndef CRC_TAG_STORE_H
+#define CRC_TAG_STORE_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Structure-of-arrays tag store for CRC_CACHE. All state lives in a single   //
+// cache-line-aligned block of the cache's arena (arena.h):                   //
+//                                                                            //
+//   tags      numsets x stride tags, the ways of a set are contiguous and    //
+//             every set starts on a cache line (stride = assoc rounded up    //
+//             to a whole line of tags)                                       //
+//   valid     one bit per way, one word per set                              //
+//   dirty     one bit per way, one word per set                              //
+//   sharing   the sharing directory of every line, only touched on fills     //
+//             and hits                                                       //
+//                                                                            //
+// A lookup therefore reads one valid word and the tag lines of one set. The  //
+// LINE_STATE view used by the replacement policy interface is materialized   //
+// on demand by GetLine/GetSet.                                               //
+//                                                                            //
+// Lookups compare all ways of a set at once with the vector kernel chosen    //
+// by SelectTagMatch (see tag_match.h).                                       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cassert>
+#include "utils.h"
+#include "crc_cache_defs.h"
+#include "tag_match.h"
+#include "prefetch.h"
+#include "checkpoint.h"
+#include "arena.h"
+
+#define CRC_TAG_STORE_ALIGN   64
+#define CRC_TAG_STORE_MAXWAYS 64      // valid/dirty bits must fit a BITVECTOR
+#define CRC_INVALID_TAG       0xdeaddead
+
+class CRC_TAG_STORE
+{
+  private:
+
+    UINT32      numsets;
+    UINT32      assoc;
+    UINT32      stride;       // tags per set including padding
+    BITVECTOR   waysMask;     // one bit for every implemented way
+    TAG_MATCH_FN match;       // tag compare kernel for this host
+
+    void       *base;         // the single block everything lives in
+    size_t      baseBytes;
+    Addr_t     *tags;
+    BITVECTOR  *valid;
+    BITVECTOR  *dirty;
+    BITVECTOR  *sharing;
+
+  public:
+
+    // The arrays are allocated from arena, which must outlive the store
+    CRC_TAG_STORE( UINT32 _sets, UINT32 _assoc, CRC_ARENA *arena );
+
+    // Returns the way holding tag, or -1 on a miss
+    INT32 Lookup( UINT32 setIndex, Addr_t tag ) const
+    {
+        BITVECTOR hits = match( tags + (size_t) setIndex * stride, stride, tag ) & valid[ setIndex ];
+
+        return hits ? __builtin_ctzll( hits ) : -1;
+    }
+
+    bool  Valid( UINT32 setIndex, UINT32 way ) const { return (valid[ setIndex ] >> way) & 1; }
+
+    // Returns the lowest invalid way, or -1 if the set is full
+    INT32 FirstInvalid( UINT32 setIndex ) const
+    {
+        BITVECTOR freeWays = ~valid[ setIndex ] & waysMask;
+
+        return freeWays ? __builtin_ctzll( freeWays ) : -1;
+    }
+
+    void Fill( UINT32 setIndex, UINT32 way, Addr_t tag, bool isDirty, BITVECTOR sharers )
+    {
+        BITVECTOR bit = 1ULL << way;
+
+        tags[ (size_t) setIndex * stride + way ]     = tag;
+        valid[ setIndex ]                          |= bit;
+        dirty[ setIndex ]                           = isDirty ? (dirty[ setIndex ] | bit) : (dirty[ setIndex ] & ~bit);
+        sharing[ (size_t) setIndex * assoc + way ]   = sharers;
+    }
+
+    void Touch( UINT32 setIndex, UINT32 way, bool isDirty, BITVECTOR sharers )
+    {
+        if( isDirty ) dirty[ setIndex ] |= 1ULL << way;
+        sharing[ (size_t) setIndex * assoc + way ] |= sharers;
+    }
+
+    // Fill and Touch without sharers, for warmup; a fill still clears the
+    // sharers of the line it replaces
+    void FillTag( UINT32 setIndex, UINT32 way, Addr_t tag, bool isDirty )
+    {
+        BITVECTOR bit = 1ULL << way;
+
+        tags[ (size_t) setIndex * stride + way ]     = tag;
+        valid[ setIndex ]                          |= bit;
+        dirty[ setIndex ]                           = isDirty ? (dirty[ setIndex ] | bit) : (dirty[ setIndex ] & ~bit);
+        sharing[ (size_t) setIndex * assoc + way ]   = 0;
+    }
+
+    void TouchDirty( UINT32 setIndex, UINT32 way, bool isDirty )
+    {
+        if( isDirty ) dirty[ setIndex ] |= 1ULL << way;
+    }
+
+    // Prefetch the lines a lookup and fill of the set touches: the tags and
+    // valid bits are read, dirty bits and sharing directory written
+    void PrefetchSet( UINT32 setIndex ) const
+    {
+        CRC_PrefetchRange( tags + (size_t) setIndex * stride, assoc * sizeof(Addr_t), false );
+        CRC_PrefetchRange( valid + setIndex, sizeof(BITVECTOR), false );
+        CRC_PrefetchRange( dirty + setIndex, sizeof(BITVECTOR), true );
+        CRC_PrefetchRange( sharing + (size_t) setIndex * assoc, assoc * sizeof(BITVECTOR), true );
+    }
+
+    // Materialize the LINE_STATE of one way / of a whole set
+    void GetLine( UINT32 setIndex, UINT32 way, LINE_STATE *line ) const
+    {
+        line->valid       = (valid[ setIndex ] >> way) & 1;
+        line->tag         = tags[ (size_t) setIndex * stride + way ];
+        line->dirty       = (dirty[ setIndex ] >> way) & 1;
+        line->sharing_dir = sharing[ (size_t) setIndex * assoc + way ];
+    }
+
+    void GetSet( UINT32 setIndex, LINE_STATE *lines ) const
+    {
+        for(UINT32 way=0; way<assoc; way++) GetLine( setIndex, way, &lines[way] );
+    }
+
+    const char * MatchKernel() const { return TagMatchName( match ); }
+
+    // The whole store as one checkpoint section (checkpoint.h)
+    void Save( CRC_CHECKPOINT_WRITER *ckpt ) const;
+    bool Restore( CRC_CHECKPOINT_READER *ckpt );
+
+  private:
+
+    CRC_TAG_STORE( const CRC_TAG_STORE & );
+    CRC_TAG_STORE & operator=( const CRC_TAG_STORE & );
+};
+
+#endif
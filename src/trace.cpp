@@ -0,0 +1,277 @@
+#include "trace.h"
+#include "trace_compress.h"
+
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define TRACE_WRITE_BUFFER_RECORDS  65536
+#define TRACE_READ_BATCH_RECORDS    (1 << 20)
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function sniffs the magic number of the file and opens the matching    //
+// reader                                                                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+TRACE_SOURCE * OpenTraceSource( const char *path )
+{
+    COUNTER magic = 0;
+    FILE   *fp    = fopen( path, "rb" );
+
+    if( fp == NULL )
+    {
+        cerr<<"trace: cannot open "<<path<<endl;
+        return NULL;
+    }
+
+    size_t got = fread( &magic, sizeof(magic), 1, fp );
+    fclose( fp );
+
+    if( got == 1 && magic == CRC_CTRACE_MAGIC )
+    {
+        CTRACE_READER *reader = new CTRACE_READER();
+        if( reader->Open( path ) ) return reader;
+        delete reader;
+        return NULL;
+    }
+
+    TRACE_READER *reader = new TRACE_READER();
+    if( reader->Open( path ) ) return reader;
+    delete reader;
+    return NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The trace reader starts off with nothing mapped                            //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+TRACE_READER::TRACE_READER()
+{
+    fd      = -1;
+    mapBase = NULL;
+    mapSize = 0;
+    header  = NULL;
+    records = NULL;
+    cursor  = 0;
+}
+
+TRACE_READER::~TRACE_READER()
+{
+    Close();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function maps the trace file and validates its header and records.     //
+// Returns false (with an explanation on cerr) if the file is not a usable    //
+// binary trace.                                                              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool TRACE_READER::Open( const char *path )
+{
+    struct stat st;
+
+    Close();
+
+    fd = open( path, O_RDONLY );
+    if( fd < 0 || fstat( fd, &st ) != 0 )
+    {
+        cerr<<"trace: cannot open "<<path<<endl;
+        Close();
+        return false;
+    }
+
+    mapSize = st.st_size;
+    if( mapSize < sizeof(TRACE_FILE_HEADER) )
+    {
+        cerr<<"trace: "<<path<<" is too short to be a trace"<<endl;
+        Close();
+        return false;
+    }
+
+    mapBase = mmap( NULL, mapSize, PROT_READ, MAP_SHARED, fd, 0 );
+    if( mapBase == MAP_FAILED )
+    {
+        mapBase = NULL;
+        cerr<<"trace: cannot mmap "<<path<<endl;
+        Close();
+        return false;
+    }
+
+    // We walk the records front to back exactly once
+    madvise( mapBase, mapSize, MADV_SEQUENTIAL );
+    madvise( mapBase, mapSize, MADV_WILLNEED );
+
+    header = (const TRACE_FILE_HEADER *) mapBase;
+
+    if( header->magic != CRC_TRACE_MAGIC || header->version != CRC_TRACE_VERSION
+        || header->recordSize != sizeof(TRACE_RECORD) )
+    {
+        cerr<<"trace: "<<path<<" is not a version "<<CRC_TRACE_VERSION<<" binary trace"<<endl;
+        Close();
+        return false;
+    }
+
+    if( sizeof(TRACE_FILE_HEADER) + header->numRecords * sizeof(TRACE_RECORD) > mapSize )
+    {
+        cerr<<"trace: "<<path<<" is truncated"<<endl;
+        Close();
+        return false;
+    }
+
+    records = (const TRACE_RECORD *) ((const char *) mapBase + sizeof(TRACE_FILE_HEADER));
+    cursor  = 0;
+
+    // The thread and access type of every record index per-thread and
+    // per-type state of the simulator, so they are checked once up front
+    for(COUNTER r=0; r<header->numRecords; r++)
+    {
+        if( records[r].tid >= header->numThreads || records[r].accessType >= ACCESS_MAX )
+        {
+            cerr<<"trace: record "<<r<<" of "<<path<<" has thread "<<records[r].tid
+                <<" and access type "<<records[r].accessType<<", the trace has "
+                <<header->numThreads<<" threads"<<endl;
+            Close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function hands out the next chunk of the mapping                       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+UINT32 TRACE_READER::NextBatch( const TRACE_RECORD **batch )
+{
+    COUNTER left = NumRecords() - cursor;
+    UINT32  n    = (left < TRACE_READ_BATCH_RECORDS) ? (UINT32) left : TRACE_READ_BATCH_RECORDS;
+
+    *batch  = records + cursor;
+    cursor += n;
+
+    return n;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function unmaps the trace                                              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void TRACE_READER::Close()
+{
+    if( mapBase ) munmap( mapBase, mapSize );
+    if( fd >= 0 ) close( fd );
+
+    fd      = -1;
+    mapBase = NULL;
+    mapSize = 0;
+    header  = NULL;
+    records = NULL;
+    cursor  = 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The trace writer starts off with no file open                              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+TRACE_WRITER::TRACE_WRITER()
+{
+    fp       = NULL;
+    buffer   = new TRACE_RECORD[ TRACE_WRITE_BUFFER_RECORDS ];
+    buffered = 0;
+
+    memset( &header, 0, sizeof(header) );
+}
+
+TRACE_WRITER::~TRACE_WRITER()
+{
+    Close();
+    delete [] buffer;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function creates the trace file and reserves space for the header      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool TRACE_WRITER::Open( const char *path )
+{
+    Close();
+
+    fp = fopen( path, "wb" );
+    if( fp == NULL )
+    {
+        cerr<<"trace: cannot create "<<path<<endl;
+        return false;
+    }
+
+    memset( &header, 0, sizeof(header) );
+    header.magic      = CRC_TRACE_MAGIC;
+    header.version    = CRC_TRACE_VERSION;
+    header.recordSize = sizeof(TRACE_RECORD);
+
+    buffered = 0;
+
+    return fwrite( &header, sizeof(header), 1, fp ) == 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function appends one access to the trace                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void TRACE_WRITER::Write( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType )
+{
+    assert( fp );
+
+    TRACE_RECORD &rec = buffer[ buffered++ ];
+
+    rec.PC         = PC;
+    rec.paddr      = paddr;
+    rec.tid        = tid;
+    rec.accessType = accessType;
+
+    if( tid >= header.numThreads ) header.numThreads = tid + 1;
+    header.numRecords++;
+
+    if( buffered == TRACE_WRITE_BUFFER_RECORDS ) Flush();
+}
+
+bool TRACE_WRITER::Flush()
+{
+    bool ok = (fwrite( buffer, sizeof(TRACE_RECORD), buffered, fp ) == buffered);
+
+    buffered = 0;
+
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function flushes outstanding records and rewrites the header with the  //
+// final record and thread counts                                             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool TRACE_WRITER::Close()
+{
+    if( fp == NULL ) return true;
+
+    bool ok = Flush();
+
+    ok = ok && (fseek( fp, 0, SEEK_SET ) == 0);
+    ok = ok && (fwrite( &header, sizeof(header), 1, fp ) == 1);
+    ok = (fclose( fp ) == 0) && ok;
+
+    fp = NULL;
+
+    return ok;
+}
@@ -0,0 +1,137 @@
+#ifndef CRC_TRACE_H
+#define CRC_TRACE_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Binary LLC access traces. A trace file is a TRACE_FILE_HEADER followed by  //
+// numRecords fixed-size TRACE_RECORDs, laid out exactly as they are in       //
+// memory so that the reader can mmap the file and hand records straight to   //
+// CRC_CACHE::LookupAndFillCache without any per-record parsing.              //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <cstdio>
+#include "utils.h"
+#include "crc_cache_defs.h"
+
+#define CRC_TRACE_MAGIC    0x0031435254435243ULL   // "CRCTRC1\0"
+#define CRC_TRACE_VERSION  1
+
+// File header, always at offset 0
+typedef struct
+{
+    COUNTER     magic;       // CRC_TRACE_MAGIC
+    UINT32      version;     // CRC_TRACE_VERSION
+    UINT32      recordSize;  // sizeof(TRACE_RECORD) of the writer
+    COUNTER     numRecords;  // number of records following the header
+    UINT32      numThreads;  // max tid + 1 seen by the writer
+    UINT32      reserved;
+} TRACE_FILE_HEADER;
+
+// One LLC access, in the argument order of LookupAndFillCache
+typedef struct
+{
+    Addr_t      PC;          // PC of the instruction making the access
+    Addr_t      paddr;       // physical address accessed
+    UINT32      tid;         // thread id of the access
+    UINT32      accessType;  // one of AccessTypes
+} TRACE_RECORD;
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Common interface of all trace readers. The simulator drains records in     //
+// batches; a returned batch stays valid until the next call to NextBatch.    //
+// A batch size of 0 marks the end of the trace, which may be early if the   //
+// reader found the file corrupt: Failed tells, after the last batch.         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+class TRACE_SOURCE
+{
+  public:
+
+    virtual ~TRACE_SOURCE() {}
+
+    virtual UINT32  NextBatch( const TRACE_RECORD **batch ) = 0;
+    virtual COUNTER NumRecords() const = 0;
+    virtual UINT32  NumThreads() const = 0;
+    virtual bool    Failed() const { return false; }
+};
+
+// Opens a raw or compressed trace, whichever the file turns out to be.
+// Returns NULL (with an explanation on cerr) on failure.
+TRACE_SOURCE * OpenTraceSource( const char *path );
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Read-only view of a binary trace. The whole file is memory-mapped and the  //
+// records are accessed in place; the kernel is told that we stream through   //
+// it sequentially so readahead keeps up with the simulator.                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+class TRACE_READER : public TRACE_SOURCE
+{
+  private:
+
+    int                       fd;
+    void                     *mapBase;
+    size_t                    mapSize;
+    const TRACE_FILE_HEADER  *header;
+    const TRACE_RECORD       *records;
+    COUNTER                   cursor;     // next record handed out by NextBatch
+
+  public:
+
+    TRACE_READER();
+    ~TRACE_READER();
+
+    bool   Open( const char *path );
+    void   Close();
+
+    const TRACE_RECORD * Records() const { return records; }
+    COUNTER NumRecords() const { return header ? header->numRecords : 0; }
+    UINT32  NumThreads() const { return header ? header->numThreads : 0; }
+
+    // Batches point straight into the mapping
+    UINT32  NextBatch( const TRACE_RECORD **batch );
+
+  private:
+
+    TRACE_READER( const TRACE_READER & );
+    TRACE_READER & operator=( const TRACE_READER & );
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Writer for binary traces. Records are buffered and written in large        //
+// chunks; the header is finalized with the record and thread counts when     //
+// the trace is closed.                                                       //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+class TRACE_WRITER
+{
+  private:
+
+    FILE              *fp;
+    TRACE_RECORD      *buffer;
+    UINT32             buffered;
+    TRACE_FILE_HEADER  header;
+
+  public:
+
+    TRACE_WRITER();
+    ~TRACE_WRITER();
+
+    bool   Open( const char *path );
+    void   Write( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType );
+    bool   Close();
+
+  private:
+
+    bool   Flush();
+
+    TRACE_WRITER( const TRACE_WRITER & );
+    TRACE_WRITER & operator=( const TRACE_WRITER & );
+};
+
+#endif
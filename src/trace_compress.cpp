@@ -0,0 +1,443 @@
+#include "trace_compress.h"
+
+#include <cassert>
+#include <cstring>
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Varint and zigzag helpers                                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+static inline unsigned char * PutVarint( unsigned char *p, Addr_t v )
+{
+    while( v >= 0x80 )
+    {
+        *p++ = (unsigned char) (v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (unsigned char) v;
+
+    return p;
+}
+
+// Returns NULL if the varint runs past end
+static inline const unsigned char * GetVarint( const unsigned char *p, const unsigned char *end, Addr_t *v )
+{
+    Addr_t result = 0;
+    UINT32 shift  = 0;
+
+    while( p < end && shift < 64 )
+    {
+        unsigned char byte = *p++;
+        result |= (Addr_t) (byte & 0x7f) << shift;
+        if( (byte & 0x80) == 0 )
+        {
+            *v = result;
+            return p;
+        }
+        shift += 7;
+    }
+
+    return NULL;
+}
+
+static inline Addr_t ZigZag( Addr_t delta )
+{
+    return (delta << 1) ^ (Addr_t) ((long long) delta >> 63);
+}
+
+static inline Addr_t UnZigZag( Addr_t v )
+{
+    return (v >> 1) ^ (Addr_t) -(long long) (v & 1);
+}
+
+#define CTRACE_PC_SAME   0x80
+#define CTRACE_TID_ESC   15
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The compressed trace writer starts off with no file open                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+CTRACE_WRITER::CTRACE_WRITER()
+{
+    fp           = NULL;
+    block        = new unsigned char[ CTRACE_BLOCK_RECORDS * CTRACE_MAX_REC_BYTES ];
+    blockBytes   = 0;
+    blockRecords = 0;
+    bytesWritten = 0;
+
+    memset( &header, 0, sizeof(header) );
+}
+
+CTRACE_WRITER::~CTRACE_WRITER()
+{
+    Close();
+    delete [] block;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function creates the trace file and reserves space for the header      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool CTRACE_WRITER::Open( const char *path )
+{
+    Close();
+
+    fp = fopen( path, "wb" );
+    if( fp == NULL )
+    {
+        cerr<<"trace: cannot create "<<path<<endl;
+        return false;
+    }
+
+    memset( &header, 0, sizeof(header) );
+    header.magic   = CRC_CTRACE_MAGIC;
+    header.version = CRC_CTRACE_VERSION;
+
+    blockBytes   = 0;
+    blockRecords = 0;
+    bytesWritten = sizeof(header);
+    history.clear();
+
+    return fwrite( &header, sizeof(header), 1, fp ) == 1;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function encodes one access into the current block                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CTRACE_WRITER::Write( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType )
+{
+    assert( fp );
+    assert( accessType < ACCESS_MAX );
+
+    if( tid >= history.size() )
+    {
+        CTRACE_THREAD_STATE fresh = { 0, 0 };
+        history.resize( tid + 1, fresh );
+    }
+
+    CTRACE_THREAD_STATE &hist = history[ tid ];
+    unsigned char       *p    = block + blockBytes;
+    unsigned char        hdr  = (unsigned char) accessType;
+
+    hdr |= (unsigned char) ((tid < CTRACE_TID_ESC ? tid : CTRACE_TID_ESC) << 3);
+    if( PC == hist.lastPC ) hdr |= CTRACE_PC_SAME;
+
+    *p++ = hdr;
+    if( tid >= CTRACE_TID_ESC ) p = PutVarint( p, tid );
+    if( PC != hist.lastPC )     p = PutVarint( p, ZigZag( PC - hist.lastPC ) );
+    p = PutVarint( p, ZigZag( paddr - hist.lastAddr ) );
+
+    hist.lastPC   = PC;
+    hist.lastAddr = paddr;
+
+    blockBytes = p - block;
+    blockRecords++;
+
+    if( tid >= header.numThreads ) header.numThreads = tid + 1;
+    header.numRecords++;
+
+    if( blockRecords == CTRACE_BLOCK_RECORDS ) FlushBlock();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function writes out the current block and resets the delta history     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool CTRACE_WRITER::FlushBlock()
+{
+    if( blockRecords == 0 ) return true;
+
+    CTRACE_BLOCK_HEADER bh;
+    bh.numBytes   = blockBytes;
+    bh.numRecords = blockRecords;
+
+    bool ok = (fwrite( &bh, sizeof(bh), 1, fp ) == 1)
+              && (fwrite( block, 1, blockBytes, fp ) == blockBytes);
+
+    bytesWritten += sizeof(bh) + blockBytes;
+    blockBytes    = 0;
+    blockRecords  = 0;
+    history.clear();
+
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function flushes the last block and finalizes the header               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool CTRACE_WRITER::Close()
+{
+    if( fp == NULL ) return true;
+
+    bool ok = FlushBlock();
+
+    ok = ok && (fseek( fp, 0, SEEK_SET ) == 0);
+    ok = ok && (fwrite( &header, sizeof(header), 1, fp ) == 1);
+    ok = (fclose( fp ) == 0) && ok;
+
+    fp = NULL;
+
+    return ok;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The compressed trace reader starts off with no file open                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+CTRACE_READER::CTRACE_READER()
+{
+    fp = NULL;
+    memset( &header, 0, sizeof(header) );
+
+    for(UINT32 s=0; s<CTRACE_RING_SLOTS; s++)
+    {
+        slots[s]       = new TRACE_RECORD[ CTRACE_BLOCK_RECORDS ];
+        slotRecords[s] = 0;
+    }
+
+    head     = 0;
+    tail     = 0;
+    holding  = false;
+    finished = false;
+    stopping = false;
+    error    = false;
+}
+
+CTRACE_READER::~CTRACE_READER()
+{
+    Close();
+
+    for(UINT32 s=0; s<CTRACE_RING_SLOTS; s++)
+    {
+        delete [] slots[s];
+    }
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function validates the header and starts the background decoder        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool CTRACE_READER::Open( const char *path )
+{
+    Close();
+
+    fp = fopen( path, "rb" );
+    if( fp == NULL )
+    {
+        cerr<<"trace: cannot open "<<path<<endl;
+        return false;
+    }
+
+    if( fread( &header, sizeof(header), 1, fp ) != 1
+        || header.magic != CRC_CTRACE_MAGIC || header.version != CRC_CTRACE_VERSION )
+    {
+        cerr<<"trace: "<<path<<" is not a version "<<CRC_CTRACE_VERSION<<" compressed trace"<<endl;
+        Close();
+        return false;
+    }
+
+    head     = 0;
+    tail     = 0;
+    holding  = false;
+    finished = false;
+    stopping = false;
+    error    = false;
+
+    decoder = thread( &CTRACE_READER::DecodeLoop, this );
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function stops the decoder (if still running) and closes the file      //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CTRACE_READER::Close()
+{
+    if( decoder.joinable() )
+    {
+        {
+            unique_lock<mutex> guard( lock );
+            stopping = true;
+        }
+        notFull.notify_all();
+        decoder.join();
+    }
+
+    if( fp ) fclose( fp );
+    fp = NULL;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function hands the next decoded batch to the simulator, returning the  //
+// slot of the previous batch to the decoder first                            //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+UINT32 CTRACE_READER::NextBatch( const TRACE_RECORD **batch )
+{
+    unique_lock<mutex> guard( lock );
+
+    if( holding )
+    {
+        head++;
+        holding = false;
+        notFull.notify_one();
+    }
+
+    while( head == tail && !finished )
+    {
+        notEmpty.wait( guard );
+    }
+
+    if( head == tail ) return 0;
+
+    holding = true;
+    *batch  = slots[ head % CTRACE_RING_SLOTS ];
+
+    return slotRecords[ head % CTRACE_RING_SLOTS ];
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Body of the decoder thread: read a block, decode it into the next free     //
+// slot, publish it. The blocks must add up to the records of the header, or  //
+// the file was cut off (possibly at a block boundary) or is corrupt.         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+void CTRACE_READER::DecodeLoop()
+{
+    vector<unsigned char>        data;
+    vector<CTRACE_THREAD_STATE>  history;
+    CTRACE_BLOCK_HEADER          bh;
+    COUNTER                      decoded = 0;
+    bool                         failed  = false;
+
+    while( fread( &bh, sizeof(bh), 1, fp ) == 1 )
+    {
+        // A corrupt header must not make us allocate a huge payload buffer
+        if( bh.numRecords == 0 || bh.numRecords > CTRACE_BLOCK_RECORDS
+            || bh.numBytes > CTRACE_BLOCK_RECORDS * CTRACE_MAX_REC_BYTES
+            || decoded + bh.numRecords > header.numRecords )
+        {
+            failed = true;
+            break;
+        }
+
+        data.resize( bh.numBytes );
+        if( fread( data.data(), 1, bh.numBytes, fp ) != bh.numBytes )
+        {
+            failed = true;
+            break;
+        }
+
+        // Wait for a free slot
+        TRACE_RECORD *out;
+        {
+            unique_lock<mutex> guard( lock );
+            while( tail - head == CTRACE_RING_SLOTS && !stopping )
+            {
+                notFull.wait( guard );
+            }
+            if( stopping ) return;
+            out = slots[ tail % CTRACE_RING_SLOTS ];
+        }
+
+        // Decode outside the lock; the slot is ours until we publish it
+        if( !DecodeBlock( data.data(), bh.numBytes, bh.numRecords, out, history ) )
+        {
+            failed = true;
+            break;
+        }
+
+        {
+            unique_lock<mutex> guard( lock );
+            slotRecords[ tail % CTRACE_RING_SLOTS ] = bh.numRecords;
+            tail++;
+        }
+        notEmpty.notify_one();
+
+        decoded += bh.numRecords;
+    }
+
+    if( !failed && (!feof( fp ) || decoded != header.numRecords) ) failed = true;
+
+    {
+        unique_lock<mutex> guard( lock );
+        error    = failed;
+        finished = true;
+    }
+    notEmpty.notify_one();
+
+    if( failed ) cerr<<"trace: compressed trace is corrupt or truncated"<<endl;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// The function decodes one block into out. Returns false if the payload      //
+// does not hold exactly numRecords well-formed accesses.                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+bool CTRACE_READER::DecodeBlock( const unsigned char *data, UINT32 numBytes, UINT32 numRecords,
+                                 TRACE_RECORD *out, vector<CTRACE_THREAD_STATE> &history )
+{
+    const unsigned char *p   = data;
+    const unsigned char *end = data + numBytes;
+
+    history.clear();
+
+    for(UINT32 r=0; r<numRecords; r++)
+    {
+        if( p >= end ) return false;
+
+        unsigned char hdr = *p++;
+        Addr_t        tid = (hdr >> 3) & CTRACE_TID_ESC;
+        Addr_t        v;
+
+        // Three bits hold the access type, but not every value is one
+        if( (hdr & 0x7) >= ACCESS_MAX ) return false;
+
+        if( tid == CTRACE_TID_ESC )
+        {
+            if( (p = GetVarint( p, end, &tid )) == NULL ) return false;
+        }
+
+        // The writer records the largest tid, which also bounds the history
+        if( tid >= header.numThreads ) return false;
+
+        if( tid >= history.size() )
+        {
+            CTRACE_THREAD_STATE fresh = { 0, 0 };
+            history.resize( tid + 1, fresh );
+        }
+
+        CTRACE_THREAD_STATE &hist = history[ tid ];
+
+        if( (hdr & CTRACE_PC_SAME) == 0 )
+        {
+            if( (p = GetVarint( p, end, &v )) == NULL ) return false;
+            hist.lastPC += UnZigZag( v );
+        }
+
+        if( (p = GetVarint( p, end, &v )) == NULL ) return false;
+        hist.lastAddr += UnZigZag( v );
+
+        out[r].PC         = hist.lastPC;
+        out[r].paddr      = hist.lastAddr;
+        out[r].tid        = (UINT32) tid;
+        out[r].accessType = hdr & 0x7;
+    }
+
+    return p == end;
+}
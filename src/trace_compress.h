@@ -0,0 +1,151 @@
+#ifndef CRC_TRACE_COMPRESS_H
+#define CRC_TRACE_COMPRESS_H
+
+////////////////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Compressed LLC access traces. The file is a CTRACE_FILE_HEADER followed    //
+// by independent blocks of up to CTRACE_BLOCK_RECORDS accesses. Within a     //
+// block every access is encoded as:                                          //
+//                                                                            //
+//   header byte   bits 0-2 accessType, bits 3-6 tid (15 = tid follows),      //
+//                 bit 7 set if PC is unchanged for this thread               //
+//   [varint]      tid, only when the header tid field is 15                  //
+//   [varint]      zigzag PC delta against the thread's previous PC           //
+//   varint        zigzag paddr delta against the thread's previous paddr     //
+//                                                                            //
+// The per-thread PC/paddr history is reset at every block boundary, so       //
+// blocks decode independently of each other.                                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "trace.h"
+
+#define CRC_CTRACE_MAGIC      0x005a5254435243ULL   // "CRCTRZ\0\0"
+#define CRC_CTRACE_VERSION    1
+
+#define CTRACE_BLOCK_RECORDS  65536
+#define CTRACE_MAX_REC_BYTES  26       // header + 3 worst-case varints
+#define CTRACE_RING_SLOTS     4
+
+// File header, always at offset 0
+typedef struct
+{
+    COUNTER     magic;       // CRC_CTRACE_MAGIC
+    UINT32      version;     // CRC_CTRACE_VERSION
+    UINT32      numThreads;  // max tid + 1 seen by the writer
+    COUNTER     numRecords;  // total number of encoded accesses
+} CTRACE_FILE_HEADER;
+
+// Precedes the payload of every block
+typedef struct
+{
+    UINT32      numBytes;    // encoded payload size
+    UINT32      numRecords;  // accesses in this block
+} CTRACE_BLOCK_HEADER;
+
+// Delta history for one thread
+typedef struct
+{
+    Addr_t      lastPC;
+    Addr_t      lastAddr;
+} CTRACE_THREAD_STATE;
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Writer for compressed traces                                               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+class CTRACE_WRITER
+{
+  private:
+
+    FILE                              *fp;
+    unsigned char                     *block;
+    UINT32                             blockBytes;
+    UINT32                             blockRecords;
+    vector<CTRACE_THREAD_STATE>        history;
+    CTRACE_FILE_HEADER                 header;
+    COUNTER                            bytesWritten;
+
+  public:
+
+    CTRACE_WRITER();
+    ~CTRACE_WRITER();
+
+    bool   Open( const char *path );
+    void   Write( UINT32 tid, Addr_t PC, Addr_t paddr, UINT32 accessType );
+    bool   Close();
+
+    // Bytes written so far, for reporting compression ratios
+    COUNTER BytesWritten() const { return bytesWritten; }
+
+  private:
+
+    bool   FlushBlock();
+
+    CTRACE_WRITER( const CTRACE_WRITER & );
+    CTRACE_WRITER & operator=( const CTRACE_WRITER & );
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+// Streaming reader for compressed traces. A background thread reads and      //
+// decodes blocks into a ring of CTRACE_RING_SLOTS record batches, which the  //
+// simulator drains through NextBatch. The decoder only stalls when the ring  //
+// is full, i.e. when the simulator is the bottleneck.                        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+class CTRACE_READER : public TRACE_SOURCE
+{
+  private:
+
+    FILE                              *fp;
+    CTRACE_FILE_HEADER                 header;
+
+    // Ring of decoded batches: the decoder fills slot (tail % SLOTS), the
+    // simulator drains slot (head % SLOTS)
+    TRACE_RECORD                      *slots[ CTRACE_RING_SLOTS ];
+    UINT32                             slotRecords[ CTRACE_RING_SLOTS ];
+    COUNTER                            head;
+    COUNTER                            tail;
+    bool                               holding;    // simulator owns slot head
+    bool                               finished;   // decoder reached the end
+    bool                               stopping;   // reader is being closed
+    bool                               error;
+
+    mutex                              lock;
+    condition_variable                 notEmpty;
+    condition_variable                 notFull;
+    thread                             decoder;
+
+  public:
+
+    CTRACE_READER();
+    ~CTRACE_READER();
+
+    bool    Open( const char *path );
+    void    Close();
+
+    UINT32  NextBatch( const TRACE_RECORD **batch );
+    COUNTER NumRecords() const { return header.numRecords; }
+    UINT32  NumThreads() const { return header.numThreads; }
+
+    // True if the stream ended early because the file was corrupt
+    bool    Failed() const { return error; }
+
+  private:
+
+    void    DecodeLoop();
+    bool    DecodeBlock( const unsigned char *data, UINT32 numBytes, UINT32 numRecords,
+                         TRACE_RECORD *out, vector<CTRACE_THREAD_STATE> &history );
+
+    CTRACE_READER( const CTRACE_READER & );
+    CTRACE_READER & operator=( const CTRACE_READER & );
+};
+
+#endif